@@ -6,6 +6,7 @@ pip install pyinstaller
 REM "=== RUNNING PYINSTALLER ==="
 IF EXIST dist RMDIR /S /Q dist
 pyinstaller main.py --onefile --icon=icon.ico
+pyinstaller hkbtool.py --onefile --icon=icon.ico
 
 REM "=== COPYING ADDITIONAL FILES ==="
 REN dist\main.exe hkbeditor.exe
@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+"""Measures how much memory loaded behaviors occupy and how much ephemeral value handlers allocate.
+
+    python -m hkb_editor.benchmarks.memory path/to/c0000.xml [more.xml ...]
+
+The resident size covers everything including the xml trees held by libxml2, while the python heap only counts objects allocated by python (records, lxml proxies, caches).
+
+Pass `--report` to also print a breakdown of each behavior's memory by subsystem, type and object.
+"""
+import argparse
+import gc
+import os
+import sys
+import time
+import tracemalloc
+import psutil
+
+from hkb_editor.hkb.behavior import HavokBehavior
+from hkb_editor.hkb.memory_report import memory_report
+
+
+def _rss() -> int:
+    gc.collect()
+    return psutil.Process().memory_info().rss
+
+
+def _mb(num_bytes: int) -> str:
+    return f"{num_bytes / (1 << 20):.1f} MB"
+
+
+def _instance_size(obj: object) -> int:
+    size = sys.getsizeof(obj)
+    if hasattr(obj, "__dict__"):
+        size += sys.getsizeof(obj.__dict__)
+    return size
+
+
+def measure_load(file_path: str) -> tuple[HavokBehavior, dict[str, int]]:
+    """Load a behavior and measure the memory it occupies.
+
+    Parameters
+    ----------
+    file_path : str
+        The behavior to load.
+
+    Returns
+    -------
+    tuple[HavokBehavior, dict[str, int]]
+        The loaded behavior and the growth of the resident size and python heap in bytes.
+    """
+    rss_before = _rss()
+    # Tracing may have been started already to include the load in a report
+    was_tracing = tracemalloc.is_tracing()
+    if not was_tracing:
+        tracemalloc.start()
+    heap_before = tracemalloc.get_traced_memory()[0]
+
+    # Undo only matters once changes are made
+    beh = HavokBehavior(file_path, undo=False)
+
+    gc.collect()
+    heap_after = tracemalloc.get_traced_memory()[0]
+    if not was_tracing:
+        tracemalloc.stop()
+    rss_after = _rss()
+
+    return beh, {
+        "rss": rss_after - rss_before,
+        "heap": heap_after - heap_before,
+    }
+
+
+def measure_access(beh: HavokBehavior) -> dict[str, float]:
+    """Access every field of every object once, creating a value handler for each.
+
+    Parameters
+    ----------
+    beh : HavokBehavior
+        The behavior to traverse.
+
+    Returns
+    -------
+    dict[str, float]
+        Number of handlers created, total bytes allocated for them and the time it took.
+    """
+    records = list(beh.objects.values())
+
+    # Timed separately as tracing allocations slows everything down considerably
+    start = time.perf_counter()
+    for record in records:
+        for name in record.fields:
+            record[name]
+    elapsed = time.perf_counter() - start
+
+    was_tracing = tracemalloc.is_tracing()
+    if not was_tracing:
+        tracemalloc.start()
+    count = 0
+    allocated = 0
+
+    for record in records:
+        before = tracemalloc.get_traced_memory()[0]
+        handlers = [record[name] for name in record.fields]
+        # Keep the handlers of one record alive to see how much they occupy together
+        allocated += tracemalloc.get_traced_memory()[0] - before
+        count += len(handlers)
+        handlers = None
+
+    if not was_tracing:
+        tracemalloc.stop()
+
+    return {"handlers": count, "bytes": allocated, "seconds": elapsed}
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("files", nargs="+", help="Behavior xml files to load")
+    parser.add_argument(
+        "--report",
+        action="store_true",
+        help="Print where the memory of each behavior goes",
+    )
+    parser.add_argument(
+        "--top", type=int, default=20, help="Number of rows per report section"
+    )
+    args = parser.parse_args()
+
+    if args.report:
+        tracemalloc.start()
+
+    behaviors = []
+    for file_path in args.files:
+        beh, load = measure_load(file_path)
+        behaviors.append(beh)
+
+        records = len(beh.objects)
+        print(
+            f"{os.path.basename(file_path)}: {records} objects, "
+            f"resident +{_mb(load['rss'])}, python heap +{_mb(load['heap'])} "
+            f"({load['heap'] / max(records, 1):.0f} bytes per object)"
+        )
+
+        access = measure_access(beh)
+        print(
+            f"  accessed {access['handlers']} fields in {access['seconds']:.2f}s, "
+            f"{access['bytes'] / max(access['handlers'], 1):.0f} bytes per handler"
+        )
+
+        if args.report:
+            report = memory_report(beh, top=args.top)
+            print()
+            print(report.format(args.top))
+            print()
+
+    print(f"Total resident size: {_mb(_rss())}")
+
+    if behaviors and behaviors[0].objects:
+        record = next(iter(behaviors[0].objects.values()))
+        print(f"HkbRecord instance size: {_instance_size(record)} bytes")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,186 @@
+#!/usr/bin/env python3
+"""Measures how long large transactions take with undo enabled, with and without a crash recovery journal.
+
+    python -m hkb_editor.benchmarks.undo [--objects 50000] [--count 10000]
+
+A synthetic tree with the given number of objects is generated, then a number of objects are deleted in a single transaction, undone and redone. The same is done for attribute changes. Every scenario runs once with just the undo stack and once with a journal attached.
+"""
+import argparse
+import os
+import shutil
+import tempfile
+import time
+
+from hkb_editor.external import load_config
+from hkb_editor.hkb.xml import HkbXmlElement, xml_from_str
+from hkb_editor.hkb.journal import Journal
+
+
+class _XmlFile:
+    # Just enough of a tagfile for the journal
+    def __init__(self, root: HkbXmlElement, file: str):
+        self._tree = root
+        self.file = file
+
+    def is_undo_enabled(self) -> bool:
+        return True
+
+
+def make_tree(num_objects: int) -> HkbXmlElement:
+    """Generate a tree that is structured like a behavior, with all objects sharing the same parent.
+
+    Parameters
+    ----------
+    num_objects : int
+        Number of objects to generate.
+
+    Returns
+    -------
+    HkbXmlElement
+        Root of the new tree, with undo enabled.
+    """
+    objects = "".join(
+        f'<object id="object{i}" typeid="type1"><record>'
+        f'<field name="name"><string value="Object{i}"/></field>'
+        f'<field name="value"><integer value="{i}"/></field>'
+        "</record></object>"
+        for i in range(num_objects)
+    )
+    return xml_from_str(f'<hktagfile version="3">{objects}</hktagfile>', undo=True)
+
+
+def _timed(func) -> float:
+    start = time.perf_counter()
+    func()
+    return time.perf_counter() - start
+
+
+def measure_delete(root: HkbXmlElement, count: int) -> dict[str, float]:
+    """Delete every n-th object in one transaction, then undo and redo it.
+
+    Parameters
+    ----------
+    root : HkbXmlElement
+        Root of a tree created by [make_tree][].
+    count : int
+        Number of objects to delete.
+
+    Returns
+    -------
+    dict[str, float]
+        Seconds it took to apply, undo and redo the transaction.
+    """
+    undo_stack = root.undo_stack
+    objects = list(root)
+    step = max(len(objects) // count, 1)
+    victims = objects[::step][:count]
+
+    def delete():
+        with undo_stack.transaction():
+            for obj in victims:
+                root.remove(obj)
+
+    ret = {"apply": _timed(delete)}
+    assert len(root) == len(objects) - len(victims)
+
+    ret["undo"] = _timed(undo_stack.undo)
+    undo_stack.notify()
+    assert len(root) == len(objects)
+
+    ret["redo"] = _timed(undo_stack.redo)
+    undo_stack.notify()
+
+    undo_stack.undo()
+    undo_stack.notify()
+    return ret
+
+
+def measure_attributes(root: HkbXmlElement, count: int) -> dict[str, float]:
+    """Change an attribute of every n-th object in one transaction, then undo and redo it.
+
+    Parameters
+    ----------
+    root : HkbXmlElement
+        Root of a tree created by [make_tree][].
+    count : int
+        Number of attributes to change.
+
+    Returns
+    -------
+    dict[str, float]
+        Seconds it took to apply, undo and redo the transaction.
+    """
+    undo_stack = root.undo_stack
+    values = root.xpath(".//field[@name='name']/string")
+    step = max(len(values) // count, 1)
+    values = values[::step][:count]
+
+    def change():
+        with undo_stack.transaction():
+            for idx, elem in enumerate(values):
+                elem.set("value", f"Renamed{idx}")
+
+    ret = {"apply": _timed(change)}
+
+    ret["undo"] = _timed(undo_stack.undo)
+    undo_stack.notify()
+
+    ret["redo"] = _timed(undo_stack.redo)
+    undo_stack.notify()
+
+    undo_stack.undo()
+    undo_stack.notify()
+    return ret
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument(
+        "--objects", type=int, default=50000, help="Number of objects in the tree"
+    )
+    parser.add_argument(
+        "--count",
+        type=int,
+        default=10000,
+        help="Number of objects to delete and attributes to change",
+    )
+    args = parser.parse_args()
+
+    tmp_dir = tempfile.mkdtemp()
+
+    try:
+        # Undo stacks are sized by the config, use the defaults rather than creating
+        # a config next to this script
+        load_config(os.path.join(tmp_dir, "config.yaml"))
+        root = make_tree(args.objects)
+
+        for journaled in (False, True):
+            journal = None
+            if journaled:
+                # The journal needs a file to write next to
+                path = os.path.join(tmp_dir, "benchmark.xml")
+                with open(path, "w") as f:
+                    f.write("")
+
+                journal = Journal(_XmlFile(root, path))
+                journal.start()
+
+            label = "journal" if journaled else "undo only"
+            for name, measure in (
+                ("delete", measure_delete),
+                ("attributes", measure_attributes),
+            ):
+                times = measure(root, args.count)
+                print(
+                    f"{name} {args.count} of {args.objects} ({label}): "
+                    + ", ".join(f"{k} {v:.2f}s" for k, v in times.items())
+                )
+
+            if journal:
+                journal.close(discard=True)
+    finally:
+        shutil.rmtree(tmp_dir, ignore_errors=True)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,401 @@
+"""Runs checks, fixes, queries and templates on many behaviors at once without the GUI.
+
+    hkbtool verify mod/chr/*/Behavior/*.xml
+    hkbtool fix --fixes clip_animation_ids clear_invalid_pointers -- c0000.xml c2010.xml
+    hkbtool query "type_name=hkbClipGenerator animationName=a000_*" c0000.xml --fields name
+    hkbtool template my_template.py c0000.xml --arg name=Hello --arg count=3
+
+Each file is handled in a separate worker process. Results are written to stdout as one JSON object per line in the order the files finish, including any warnings and errors logged while processing the file. Files must be in XML format.
+"""
+from typing import Any, Annotated, Literal, get_args, get_origin
+from concurrent.futures import ProcessPoolExecutor, as_completed
+from enum import Enum, Flag
+import argparse
+import json
+import logging
+import os
+import shutil
+import sys
+import traceback
+
+from hkb_editor.hkb.behavior import HavokBehavior
+from hkb_editor.hkb.verify import verify_behavior
+from hkb_editor.hkb.fixes import fix_common_problems, common_fixes, default_fixes
+from hkb_editor.templates import TemplateContext, Variable, Event, Animation, HkbRecord
+from hkb_editor.templates.glue import execute_template, templates_dir
+
+
+class _LogCollector(logging.Handler):
+    def __init__(self, level: int):
+        super().__init__(level)
+        self.messages: list[dict[str, str]] = []
+
+    def emit(self, record: logging.LogRecord) -> None:
+        self.messages.append(
+            {
+                "level": record.levelname.lower(),
+                "logger": record.name,
+                "message": record.getMessage(),
+            }
+        )
+
+
+def _init_worker() -> None:
+    # Workers may inherit the handlers of the main process. Everything they log is
+    # collected into the results instead.
+    root = logging.getLogger()
+    for handler in list(root.handlers):
+        root.removeHandler(handler)
+
+    root.setLevel(logging.DEBUG)
+
+
+def _parse_arg(value: str, arg_type: type) -> Any:
+    origin = get_origin(arg_type) or arg_type
+
+    if origin is Annotated:
+        return _parse_arg(value, get_args(arg_type)[0])
+
+    if origin is Literal:
+        for choice in get_args(arg_type):
+            if str(choice) == value:
+                return choice
+
+        raise ValueError(f"{value} is not one of {get_args(arg_type)}")
+
+    if isinstance(origin, type) and issubclass(origin, (Enum, Flag)):
+        # Templates receive the values of enums, just like from the GUI
+        if value.lstrip("-").isdigit():
+            return int(value)
+
+        if issubclass(origin, Flag):
+            flags = origin(0)
+            for name in value.split("|"):
+                flags |= origin[name.strip()]
+            return flags.value
+
+        return origin[value].value
+
+    if origin is bool:
+        if value.lower() in ("1", "true", "yes", "on"):
+            return True
+        if value.lower() in ("0", "false", "no", "off"):
+            return False
+
+        raise ValueError(f"{value} is not a boolean")
+
+    if origin in (int, float):
+        return origin(value)
+
+    if origin in (list, dict):
+        return json.loads(value)
+
+    # Strings, and names or queries resolved once the behavior is loaded
+    return value
+
+
+def _load(file_path: str, undo: bool) -> HavokBehavior:
+    return HavokBehavior(file_path, undo=undo)
+
+
+def _save(behavior: HavokBehavior, options: dict) -> str:
+    if options["dry_run"]:
+        return None
+
+    if options["backup"]:
+        shutil.copy(behavior.file, behavior.file + ".backup")
+
+    behavior.save_to_file(behavior.file)
+    return behavior.file
+
+
+def _verify(file_path: str, options: dict) -> dict:
+    beh = _load(file_path, False)
+    verify_behavior(beh)
+    return {}
+
+
+def _fix(file_path: str, options: dict) -> dict:
+    beh = _load(file_path, True)
+    fixes = fix_common_problems(beh, options["fixes"])
+
+    saved = None
+    if sum(fixes.values()) > 0:
+        saved = _save(beh, options)
+
+    return {"fixes": fixes, "saved": saved}
+
+
+def _query(file_path: str, options: dict) -> dict:
+    beh = _load(file_path, False)
+    matches = []
+
+    for record in beh.query(options["query"]):
+        match = {"id": record.object_id, "type": record.type_name}
+        for path in options["fields"]:
+            match[path] = record.get_field(path, None, resolve=True)
+
+        matches.append(match)
+
+    return {"matches": matches}
+
+
+def _template(file_path: str, options: dict) -> dict:
+    beh = _load(file_path, True)
+    template = TemplateContext(beh, options["template"])
+    template_name = os.path.splitext(os.path.basename(options["template"]))[0]
+    logger = logging.getLogger(template_name)
+
+    unknown = set(options["args"]).difference(template._args)
+    if unknown:
+        raise ValueError(f"Template has no arguments {sorted(unknown)}")
+
+    last_obj_id = next(reversed(beh.objects.keys()))
+
+    with beh.transaction():
+        args = {}
+        for name, arg in template._args.items():
+            value = arg.value
+            if name in options["args"]:
+                value = _parse_arg(options["args"][name], arg.type)
+
+            if value not in (None, ""):
+                # Resolve to the types the template expects
+                if arg.type == Variable:
+                    value = template.variable(value)
+                elif arg.type == Event:
+                    value = template.event(value)
+                elif arg.type == Animation:
+                    value = template.animation(value)
+                elif arg.type == HkbRecord:
+                    value = template.resolve_object(value)
+
+            args[name] = value
+
+        logger.info(f"Executing template '{template._title}'")
+        execute_template(template, **args)
+
+    # Dicts retain insertion order, so anything after the previous last key is new
+    new_objects = []
+    for oid in reversed(beh.objects.keys()):
+        if oid == last_obj_id:
+            break
+        new_objects.append(oid)
+    new_objects.reverse()
+
+    return {"new_objects": new_objects, "saved": _save(beh, options)}
+
+
+_commands = {
+    "verify": _verify,
+    "fix": _fix,
+    "query": _query,
+    "template": _template,
+}
+
+
+def run_file(command: str, file_path: str, options: dict) -> dict:
+    """Run a command on a single behavior file. This is what the worker processes execute.
+
+    Parameters
+    ----------
+    command : str
+        One of verify, fix, query or template.
+    file_path : str
+        The behavior to process.
+    options : dict
+        Command specific options as created by the argument parser.
+
+    Returns
+    -------
+    dict
+        A JSON serializable result. `ok` is False if processing failed or anything was logged at error level or above.
+    """
+    level = logging.DEBUG if options["verbose"] else logging.WARNING
+    collector = _LogCollector(level)
+    root = logging.getLogger()
+    root.addHandler(collector)
+
+    result = {"file": file_path, "command": command}
+
+    try:
+        result.update(_commands[command](file_path, options))
+    except Exception as e:
+        result["error"] = f"{type(e).__name__}: {e}"
+        if options["verbose"]:
+            result["traceback"] = traceback.format_exc()
+    finally:
+        root.removeHandler(collector)
+
+    result["ok"] = "error" not in result and not any(
+        msg["level"] in ("error", "critical") for msg in collector.messages
+    )
+    result["messages"] = collector.messages
+    return result
+
+
+def run_batch(
+    command: str, files: list[str], options: dict, jobs: int = None
+) -> list[dict]:
+    """Run a command on several behavior files in parallel worker processes. Results are printed as JSON lines as soon as they are available.
+
+    Parameters
+    ----------
+    command : str
+        One of verify, fix, query or template.
+    files : list[str]
+        The behaviors to process.
+    options : dict
+        Command specific options, see [run_file][].
+    jobs : int, optional
+        Number of worker processes. Defaults to the number of CPUs.
+
+    Returns
+    -------
+    list[dict]
+        The results in the order of the files.
+    """
+    if not jobs:
+        jobs = os.cpu_count() or 1
+
+    results: dict[str, dict] = {}
+
+    with ProcessPoolExecutor(
+        max_workers=min(jobs, len(files)), initializer=_init_worker
+    ) as executor:
+        futures = {
+            executor.submit(run_file, command, path, options): path for path in files
+        }
+
+        for future in as_completed(futures):
+            path = futures[future]
+            try:
+                result = future.result()
+            except Exception as e:
+                # The worker itself died, e.g. because it ran out of memory
+                result = {"file": path, "command": command, "ok": False}
+                result["error"] = f"{type(e).__name__}: {e}"
+
+            results[path] = result
+            print(json.dumps(result, default=str), flush=True)
+
+    return [results[path] for path in files]
+
+
+def main(argv: list[str] = None) -> int:
+    parser = argparse.ArgumentParser(
+        prog="hkbtool",
+        description=__doc__.split("\n")[0],
+        formatter_class=argparse.RawDescriptionHelpFormatter,
+        epilog="\n".join(__doc__.split("\n")[1:]),
+    )
+    subparsers = parser.add_subparsers(dest="command", required=True)
+
+    common = argparse.ArgumentParser(add_help=False)
+    common.add_argument(
+        "-j", "--jobs", type=int, default=None, help="Number of worker processes"
+    )
+    common.add_argument(
+        "-v",
+        "--verbose",
+        action="store_true",
+        help="Include info and debug messages and tracebacks in the results",
+    )
+
+    saving = argparse.ArgumentParser(add_help=False)
+    saving.add_argument(
+        "--dry-run", action="store_true", help="Don't save any modified files"
+    )
+    saving.add_argument(
+        "--backup",
+        action="store_true",
+        help="Copy each file to <file>.backup before overwriting it",
+    )
+
+    verify = subparsers.add_parser(
+        "verify", parents=[common], help="Check behaviors for common problems"
+    )
+    verify.add_argument("files", nargs="+", help="Behavior xml files")
+
+    fix = subparsers.add_parser(
+        "fix", parents=[common, saving], help="Fix common problems and save"
+    )
+    fix.add_argument(
+        "--fixes",
+        nargs="+",
+        choices=list(common_fixes.keys()),
+        default=list(default_fixes),
+        help="The fixes to apply (default: %(default)s)",
+    )
+    fix.add_argument("files", nargs="+", help="Behavior xml files")
+
+    query = subparsers.add_parser(
+        "query", parents=[common], help="Find objects matching a query"
+    )
+    query.add_argument("query", help="The query, see Tagfile.query for the syntax")
+    query.add_argument("files", nargs="+", help="Behavior xml files")
+    query.add_argument(
+        "--fields",
+        nargs="+",
+        default=[],
+        help="Attribute paths to include in the results",
+    )
+
+    template = subparsers.add_parser(
+        "template", parents=[common, saving], help="Apply a template and save"
+    )
+    template.add_argument(
+        "template", help="Template file, or its path relative to the templates folder"
+    )
+    template.add_argument("files", nargs="+", help="Behavior xml files")
+    template.add_argument(
+        "--arg",
+        action="append",
+        default=[],
+        metavar="NAME=VALUE",
+        help="Template argument, may be repeated. Lists and dicts are passed as JSON",
+    )
+
+    args = parser.parse_args(argv)
+
+    options = {"verbose": args.verbose}
+
+    if args.command in ("fix", "template"):
+        options["dry_run"] = args.dry_run
+        options["backup"] = args.backup
+
+    if args.command == "fix":
+        options["fixes"] = args.fixes
+
+    elif args.command == "query":
+        options["query"] = args.query
+        options["fields"] = args.fields
+
+    elif args.command == "template":
+        template_file = args.template
+        if not os.path.isfile(template_file):
+            template_file = os.path.join(templates_dir(), template_file)
+            if not os.path.isfile(template_file):
+                parser.error(f"Template {args.template} not found")
+
+        template_args = {}
+        for arg in args.arg:
+            name, sep, value = arg.partition("=")
+            if not sep:
+                parser.error(f"Template arguments must be NAME=VALUE, got {arg}")
+            template_args[name.strip()] = value
+
+        options["template"] = os.path.abspath(template_file)
+        options["args"] = template_args
+
+    files = list(dict.fromkeys(os.path.abspath(f) for f in args.files))
+    missing = [f for f in files if not os.path.isfile(f)]
+    if missing:
+        parser.error(f"Files not found: {missing}")
+
+    results = run_batch(args.command, files, options, args.jobs)
+    return 0 if all(res["ok"] for res in results) else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
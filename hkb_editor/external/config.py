@@ -16,6 +16,7 @@ class Config:
     single_branch_mode: bool = True
     save_backups: bool = True
     session_backup: bool = True
+    journal: bool = True
     undo_history: int = 100
 
     def add_recent_file(self, file_path: str) -> None:
@@ -1,4 +1,4 @@
-from typing import Any
+from typing import Any, Callable
 import sys
 import os
 from ast import literal_eval
@@ -35,8 +35,6 @@ from hkb_editor.external import (
     Config,
     load_config,
     xml_to_hkx,
-    hkx_to_xml,
-    unpack_binder,
     pack_binder,
 )
 
@@ -49,7 +47,15 @@ except (ImportError, AttributeError) as e:
         f"Failed to load character reloader: {e}",
     )
 
-from hkb_editor.hkb.version_updates import fix_variable_defaults
+from hkb_editor.hkb.transition_index import EventTransition
+from hkb_editor.hkb.journal import (
+    Journal,
+    has_journal,
+    get_recovery_base,
+    recover_journal,
+)
+from hkb_editor.hkb.workspace import Workspace, WorkspaceEntry, load_behaviors
+from hkb_editor.hkb.verify import verify_behavior
 
 from .widgets.graph_widget import GraphWidget, HorizontalGraphLayout, Node
 from .widgets.attributes_widget import AttributesWidget
@@ -57,13 +63,18 @@ from .widgets.graphmap import GraphMap  # TODO
 from .dialogs import (
     about_dialog,
     open_file_dialog,
+    open_multiple_dialog,
     save_file_dialog,
+    choose_folder,
     edit_simple_array_dialog,
     search_objects_dialog,
+    search_workspace_dialog,
+    select_object,
     mass_rename_dialog,
 )
 from .tools import (
     skeleton_mirror_dialog,
+    memory_report_dialog,
     eventlistener_dialog,
     open_state_graph_viewer,
 )
@@ -77,12 +88,15 @@ from .workflows.clone_hierarchy import (
     import_hierarchy,
     paste_hierarchy,
     paste_children,
+    copy_hierarchy,
+    write_hierarchies,
     MergeAction,
 )
 from .workflows.duplicate_clipcat import duplicate_clipcat_dialog
 from .workflows.fix_common_problems import fix_common_problems_dialog
-from .workflows.verify_behavior import verify_behavior
+from .workflows.deduplicate import deduplicate_dialog
 from .helpers import make_copy_menu, center_window, common_loading_indicator
+from .behavior_loader import BehaviorLoader
 from . import style
 
 
@@ -106,6 +120,8 @@ class BehaviorEditor:
 
         self.beh: HavokBehavior = None
         self._busy = False
+        self._loader: BehaviorLoader = None
+        self.workspace = Workspace()
         self.alias_manager = AliasManager()
         self.attributes_widget: AttributesWidget = None
         self.pinned_objects_table: str = None
@@ -124,7 +140,6 @@ class BehaviorEditor:
         self.canvas: GraphWidget = None
         self.attributes_table: str = None
         self.loaded_file: str = None
-        self.last_save_undo_id: int = -1
         self.selected_roots: set[str] = set()
         self.selected_node: Node = None
 
@@ -136,6 +151,24 @@ class BehaviorEditor:
         )
         dpg.set_frame_callback(dpg.get_frame_count() + 1, lambda: center_window(about))
 
+    @property
+    def journal(self) -> Journal:
+        entry = self.workspace.active
+        return entry.journal if entry else None
+
+    @journal.setter
+    def journal(self, journal: Journal) -> None:
+        self.workspace.active.journal = journal
+
+    @property
+    def last_save_undo_id(self) -> int:
+        entry = self.workspace.active
+        return entry.last_save_undo_id if entry else -1
+
+    @last_save_undo_id.setter
+    def last_save_undo_id(self, undo_id: int) -> None:
+        self.workspace.active.last_save_undo_id = undo_id
+
     def notification(self, message: str, severity: int = logging.INFO) -> None:
         if severity < self.min_notification_severity:
             return
@@ -209,84 +242,348 @@ class BehaviorEditor:
             self._regenerate_recent_files_menu()
             return
 
+        # A cancelled loader may still be waiting for an external conversion, but its
+        # result will be discarded
+        if self._loader and self._loader.running and not self._loader.cancelled:
+            self.logger.warning("Another behavior is still being loaded")
+            return
+
         if dpg.does_item_exist(f"{self.tag}_about_popup"):
             dpg.delete_item(f"{self.tag}_about_popup")
 
         self.logger.debug("======================================")
         self.logger.info("Loading file %s", file_path)
 
+        # External tools may have to be located by the user, so do this before
+        # handing off to the loader
+        if file_path.lower().endswith(".hkx"):
+            self._locate_hklib()
+        elif file_path.lower().endswith(".behbnd.dcx"):
+            self._locate_witchy()
+            self._locate_hklib()
+
+        def on_loaded(beh: HavokBehavior) -> None:
+            self._set_behavior(beh)
+            self._start_journal()
+
+        self._load_behavior(
+            file_path, on_loaded, session_backup=self.config.session_backup
+        )
+
+    def _load_behavior(
+        self,
+        file_path: str,
+        on_loaded: Callable[[HavokBehavior], None],
+        *,
+        session_backup: bool = False,
+        migrations: bool = True,
+        on_cancelled: Callable[[], None] = None,
+    ) -> None:
+        # Loads in the background with a progress window, on_loaded and on_cancelled
+        # are called from the main thread.
+        # The current behavior stays usable while the new one is loading
+        progress_window = f"{self.tag}_loading_progress"
+        if dpg.does_item_exist(progress_window):
+            dpg.delete_item(progress_window)
+
+        def on_stage(stage: str) -> None:
+            with dpg.mutex():
+                for prev, seconds in loader.timings.items():
+                    dpg.set_value(f"{progress_window}_{prev}", f"{seconds:.2f}s")
+                    dpg.configure_item(f"{progress_window}_{prev}", color=style.green)
+
+                dpg.set_value(f"{progress_window}_{stage}", "...")
+                dpg.configure_item(f"{progress_window}_{stage}", color=style.yellow)
+
+        def on_done(beh: HavokBehavior) -> None:
+            # UI changes must happen on the main thread
+            dpg.set_frame_callback(
+                dpg.get_frame_count() + 1, lambda: finish_loading(beh)
+            )
+
+        def on_error(e: Exception) -> None:
+            if loader.cancelled:
+                # The progress window may belong to another loader by now
+                self.logger.debug("Cancelled loading failed", exc_info=e)
+                return
+
+            details = traceback.format_exception_only(e)
+            self.logger.error(
+                f"Loading behavior failed: {details[0]}\nSee log for details!"
+            )
+            self.logger.debug("Loading behavior failed", exc_info=e)
+            dpg.set_frame_callback(dpg.get_frame_count() + 1, close_progress)
+
+        def cancel() -> None:
+            loader.cancel()
+            close_progress()
+
+            if on_cancelled:
+                on_cancelled()
+
+        def close_progress() -> None:
+            if dpg.does_item_exist(progress_window):
+                dpg.delete_item(progress_window)
+
+        def finish_loading(beh: HavokBehavior) -> None:
+            if loader.cancelled:
+                return
+
+            close_progress()
+            on_loaded(beh)
+
+        loader = BehaviorLoader(
+            file_path,
+            on_stage=on_stage,
+            on_done=on_done,
+            on_error=on_error,
+            session_backup=session_backup,
+            migrations=migrations,
+        )
+
         with dpg.window(
-            modal=True,
-            no_close=True,
-            no_move=True,
+            label=f"Loading {os.path.basename(file_path)}",
+            autosize=True,
             no_collapse=True,
-            no_title_bar=True,
-            no_resize=True,
-            no_scroll_with_mouse=True,
-            no_scrollbar=True,
             no_saved_settings=True,
-        ) as loading_screen:
-            dpg.add_loading_indicator(color=style.yellow)
-            dpg.add_text(f"Loading {os.path.basename(file_path)}")
+            on_close=cancel,
+            tag=progress_window,
+        ):
+            with dpg.group(horizontal=True):
+                dpg.add_loading_indicator(color=style.yellow)
+                dpg.add_text(f"Loading {os.path.basename(file_path)}")
+
             dpg.add_separator()
-            dpg.add_text("Relax, get a coffee, breathe, maybe")
-            dpg.add_text("contemplate your life choices...")
 
-        # Already centered, this will make it worse somehow
-        # dpg.split_frame(delay=64)
-        # center_window(loading_screen)
+            with dpg.table(
+                header_row=False,
+                policy=dpg.mvTable_SizingFixedFit,
+                borders_innerH=False,
+                borders_outerH=False,
+            ):
+                dpg.add_table_column()
+                dpg.add_table_column(width=60)
+
+                for stage in BehaviorLoader.stages:
+                    with dpg.table_row():
+                        dpg.add_text(stage.capitalize())
+                        dpg.add_text(
+                            "", color=style.light_blue, tag=f"{progress_window}_{stage}"
+                        )
+
+            dpg.add_separator()
+            dpg.add_button(label="Cancel", callback=cancel, width=-1)
+
+        self._loader = loader
+        loader.start()
+
+    def _set_behavior(self, beh: HavokBehavior) -> None:
+        # Replaces the active behavior, other behaviors in the workspace stay loaded.
+        # Its journal is closed but kept in case there were unsaved changes.
+        if self.workspace.active:
+            self.workspace.remove(self.workspace.active)
+
+        entry = self.workspace.add(beh, activate=True)
+        self._show_behavior(entry)
 
+    def _show_behavior(self, entry: WorkspaceEntry) -> None:
         self.alias_manager.clear()
         self.clear_attributes()
         self.remove_all_pinned_objects()
         self.close_all_dialogs()
 
-        try:
-            if file_path.lower().endswith(".hkx"):
-                self._locate_hklib()
-                self.logger.info("Converting HKX to XML...")
-                file_path = hkx_to_xml(file_path)
+        first_behavior = self.beh is None
+        self.workspace.active = entry
+        self.beh = beh = entry.behavior
+
+        self.config.add_recent_file(beh.file)
+        self.config.save()
+        self._regenerate_recent_files_menu()
+        self._regenerate_workspace_menu()
+
+        filename = os.path.basename(beh.file)
+        dpg.configure_viewport(0, title=f"HkbEditor - {filename}")
+
+        self.loaded_file = beh.file
+        self.canvas.clear()
+        self._update_roots()
+
+        self._reload_templates()
+        if first_behavior:
+            self._set_menus_enabled(True)
+
+        dpg.focus_item(f"{self.tag}_roots_filter")
+
+    def switch_behavior(self, entry: WorkspaceEntry) -> None:
+        """Make another behavior of the workspace the active one. Its undo history, journal and save state are kept while other behaviors are active.
+
+        Parameters
+        ----------
+        entry : WorkspaceEntry
+            The behavior to activate.
+        """
+        if entry is self.workspace.active or entry not in self.workspace.entries:
+            return
 
-            elif file_path.lower().endswith(".behbnd.dcx"):
-                self._locate_witchy()
-                self._locate_hklib()
-                self.logger.info("Opening binder...")
-                file_path = unpack_binder(file_path)
+        self.logger.info(f"Switched to {entry.name}")
+        self._show_behavior(entry)
 
-            self.logger.info("Loading behavior...")
-            self.beh = HavokBehavior(file_path, undo=True)
+        # Behaviors loaded alongside the active one are only journaled once they
+        # become active, so that leftover journals can be recovered
+        if entry.journal is None:
+            self._start_journal()
+
+    def file_open_additional(self) -> None:
+        ret = open_multiple_dialog(
+            title="Select behaviors to add to the workspace",
+            default_dir=os.path.dirname(self.loaded_file or ""),
+            filetypes=self.get_supported_file_extensions(),
+        )
+
+        if ret:
+            self._do_load_additional(ret)
+
+    def _do_load_additional(self, file_paths: list[str]) -> None:
+        file_paths = [p for p in file_paths if os.path.isfile(p)]
+        if not file_paths:
+            return
+
+        if any(p.lower().endswith((".hkx", ".behbnd.dcx")) for p in file_paths):
+            self._locate_hklib()
+        if any(p.lower().endswith(".behbnd.dcx") for p in file_paths):
+            self._locate_witchy()
+
+        self.logger.info(f"Adding {len(file_paths)} behaviors to the workspace...")
+        loading = common_loading_indicator(f"Loading {len(file_paths)} behaviors...")
+
+        def load(file_path: str) -> HavokBehavior:
+            loader = BehaviorLoader(
+                file_path, session_backup=self.config.session_backup
+            )
+            return loader.load()
+
+        def on_error(file_path: str, e: Exception) -> None:
+            details = traceback.format_exception_only(e)
+            self.logger.error(
+                f"Loading {os.path.basename(file_path)} failed: {details[0]}"
+            )
+            self.logger.debug("Loading behavior failed", exc_info=e)
+
+        def finish_loading(behaviors: list[HavokBehavior]) -> None:
+            dpg.delete_item(loading)
+
+            for beh in behaviors:
+                if self.workspace.find(beh.file):
+                    self.logger.warning(
+                        f"{os.path.basename(beh.file)} is already part of the workspace"
+                    )
+                    continue
+
+                self.workspace.add(beh)
+                self.config.add_recent_file(beh.file)
 
-            self.config.add_recent_file(file_path)
             self.config.save()
             self._regenerate_recent_files_menu()
 
-            # Save an initial backup that won't be overwritten on save
-            if self.config.session_backup:
-                shutil.copy(self.beh.file, self.beh.file + ".session_backup")
+            if self.beh is None and self.workspace.active:
+                self._show_behavior(self.workspace.active)
+                self._start_journal()
+            else:
+                self._regenerate_workspace_menu()
+
+            self.logger.info(f"Workspace contains {len(self.workspace)} behaviors")
+
+        def run() -> None:
+            behaviors = load_behaviors(file_paths, load_fn=load, on_error=on_error)
+            # UI changes must happen on the main thread
+            dpg.set_frame_callback(
+                dpg.get_frame_count() + 1, lambda: finish_loading(behaviors)
+            )
+
+        Thread(target=run, daemon=True).start()
+
+    def close_other_behaviors(self) -> None:
+        for entry in self.workspace:
+            if entry is self.workspace.active:
+                continue
 
-            # Fix anything that was amiss in previous versions
-            fix_variable_defaults(self.beh)
+            if entry.has_unsaved_changes():
+                self.logger.warning(
+                    f"{entry.name} has unsaved changes, switch to it to save or discard them"
+                )
+                continue
+
+            self.workspace.remove(entry)
+
+        self._regenerate_workspace_menu()
+
+    def _start_journal(self) -> None:
+        if not self.config.journal:
+            return
+
+        file_path = self.beh.file
+        if not has_journal(file_path):
+            self.journal = Journal(self.beh)
+            self.journal.start()
+            return
 
-            filename = os.path.basename(file_path)
-            dpg.configure_viewport(0, title=f"HkbEditor - {filename}")
+        def recover():
+            dpg.delete_item(wnd)
 
-            self.loaded_file = file_path
-            self.last_save_undo_id = -1
+            base = get_recovery_base(file_path)
+            if base == file_path:
+                replay_journal()
+                return
+
+            def on_snapshot_loaded(beh: HavokBehavior) -> None:
+                beh.file = file_path
+                self._set_behavior(beh)
+                replay_journal()
+
+            # Recover from the most recent snapshot. It was written by the editor, so
+            # it doesn't need any migrations. If cancelled, ask again.
+            self._load_behavior(
+                base,
+                on_snapshot_loaded,
+                migrations=False,
+                on_cancelled=self._start_journal,
+            )
+
+        def replay_journal():
+            num_changes = recover_journal(self.beh, file_path)
+            self.logger.info(f"Recovered {num_changes} unsaved changes")
+
+            # The behavior now differs from the file, even if there is nothing to undo
+            self.last_save_undo_id = None
             self.canvas.clear()
             self._update_roots()
 
-            self._reload_templates()
-            self._set_menus_enabled(True)
+            self.journal = Journal(self.beh)
+            self.journal.start(keep_changes=True)
 
-            dpg.focus_item(f"{self.tag}_roots_filter")
-        except Exception as e:
-            details = traceback.format_exception_only(e)
-            self.logger.error(
-                f"Loading behavior failed: {details[0]}\nSee log for details!"
+        def discard():
+            dpg.delete_item(wnd)
+            self.journal = Journal(self.beh)
+            self.journal.start()
+
+        with dpg.window(
+            label="Recover?",
+            autosize=True,
+            modal=True,
+            no_close=True,
+            no_saved_settings=True,
+        ) as wnd:
+            dpg.add_text(
+                "Found unsaved changes from a previous session. Do you want to recover them?"
             )
-            raise e
-        finally:
-            dpg.delete_item(loading_screen)
+            dpg.add_separator()
+
+            with dpg.group(horizontal=True):
+                dpg.add_button(label="Recover", callback=recover)
+                dpg.add_button(label="Discard", callback=discard)
+
+        dpg.split_frame()
+        center_window(wnd)
 
     def file_save(self):
         self._do_write_to_file(self.loaded_file)
@@ -320,6 +617,10 @@ class BehaviorEditor:
 
             self.beh.save_to_file(file_path)
             self.logger.info(f"Saved to {file_path}")
+
+            if self.journal:
+                # Everything journaled so far is part of the saved file now
+                self.journal.reset()
         finally:
             dpg.delete_item(loading)
             self._busy = False
@@ -400,11 +701,13 @@ class BehaviorEditor:
             self._busy = False
 
     def exit_app(self):
-        if not self.beh or self.beh.top_undo_id() == self.last_save_undo_id:
+        if not self.workspace.has_unsaved_changes():
             # Nothing was loaded or no changes have been made
             self._do_exit()
             return
 
+        unsaved = [e.name for e in self.workspace if e.has_unsaved_changes()]
+
         with dpg.window(
             label="Exit?",
             autosize=True,
@@ -412,10 +715,13 @@ class BehaviorEditor:
             no_saved_settings=True,
             on_close=lambda: dpg.delete_item(wnd),
         ) as wnd:
-            if self.last_save_undo_id != self.beh.top_undo_id():
-                dpg.add_text("You have unsaved changes. Exit anyways?")
+            if len(unsaved) > 1:
+                dpg.add_text("You have unsaved changes in:")
+                for name in unsaved:
+                    dpg.add_text(f"- {name}")
+                dpg.add_text("Exit anyways?")
             else:
-                dpg.add_text("Are you sure you want to exit?")
+                dpg.add_text("You have unsaved changes. Exit anyways?")
 
             dpg.add_separator()
 
@@ -427,6 +733,10 @@ class BehaviorEditor:
         center_window(wnd)
 
     def _do_exit(self):
+        for entry in self.workspace:
+            if entry.journal:
+                entry.journal.close(discard=True)
+
         dpg.stop_dearpygui()
         dpg.destroy_context()
         sys.exit(0)
@@ -442,8 +752,7 @@ class BehaviorEditor:
             if oid not in self.beh.objects:
                 self.remove_pinned_object(oid)
 
-        self.regenerate()
-        self.attributes_widget.regenerate()
+        self._regenerate_after_undo()
 
     def redo(self) -> None:
         if self.beh.redo() is None:
@@ -452,8 +761,18 @@ class BehaviorEditor:
 
         self.logger.debug("Redo")
 
+        self._regenerate_after_undo()
+
+    def _regenerate_after_undo(self) -> None:
+        record = self.attributes_widget.record
         self.regenerate()
-        self.attributes_widget.regenerate()
+
+        # The attributes widget updates its items from the undo notifications, it
+        # only needs to be rebuilt if it was cleared
+        if record and record.object_id in self.beh.objects:
+            self.attributes_widget.set_record(self.beh.objects[record.object_id])
+        else:
+            self.attributes_widget.clear()
 
     def create_app_menu(self):
         # File
@@ -512,6 +831,17 @@ class BehaviorEditor:
             dpg.add_separator()
             dpg.add_menu_item(label="Exit", shortcut="ctrl-q", callback=self.exit_app)
 
+        # Workspace
+        with dpg.menu(label="Workspace", tag=f"{self.tag}_menu_workspace"):
+            dpg.add_menu_item(
+                label="Add Behaviors...", callback=self.file_open_additional
+            )
+            dpg.add_menu_item(
+                label="Close Other Behaviors", callback=self.close_other_behaviors
+            )
+            dpg.add_separator()
+            dpg.add_group(tag=f"{self.tag}_menu_workspace_behaviors")
+
         dpg.add_separator()
 
         # Edit
@@ -551,6 +881,11 @@ class BehaviorEditor:
                 shortcut="ctrl-f",
                 callback=self.open_search_dialog,
             )
+            dpg.add_menu_item(
+                label="Find in Workspace...",
+                shortcut="ctrl-shift-f",
+                callback=self.open_workspace_search_dialog,
+            )
 
         # Workflows
         with dpg.menu(
@@ -580,12 +915,27 @@ class BehaviorEditor:
                 label="Fix Common Problems...",
                 callback=self.open_fix_common_problems_dialog,
             )
+            dpg.add_menu_item(
+                label="Deduplicate Objects...",
+                callback=self.open_deduplicate_dialog,
+            )
 
             dpg.add_separator()
 
             dpg.add_menu_item(
                 label="Import Hierarchy...", callback=self.open_hierarchy_import_dialog
             )
+            dpg.add_menu_item(
+                label="Import Hierarchy from Workspace...",
+                callback=self.open_workspace_hierarchy_import_dialog,
+            )
+            dpg.add_menu_item(
+                label="Export Hierarchy...", callback=self.open_hierarchy_export_dialog
+            )
+            dpg.add_menu_item(
+                label="Export Pinned Hierarchies...",
+                callback=self.open_pinned_hierarchies_export_dialog,
+            )
 
         # Tools
         with dpg.menu(label="Tools", enabled=False, tag=f"{self.tag}_menu_tools"):
@@ -611,6 +961,13 @@ class BehaviorEditor:
                 callback=self.open_mirror_skeleton_dialog,
             )
 
+            dpg.add_separator()
+
+            dpg.add_menu_item(
+                label="Memory Report...",
+                callback=self.open_memory_report_dialog,
+            )
+
         # Templates
         with dpg.menu(
             label="Templates", enabled=False, tag=f"{self.tag}_menu_templates"
@@ -652,6 +1009,14 @@ class BehaviorEditor:
                 tag=f"{self.tag}_config_session_backup",
                 user_data="session_backup",
             )
+            dpg.add_menu_item(
+                label="Crash Recovery Journal",
+                check=True,
+                default_value=self.config.journal,
+                callback=self._update_config,
+                tag=f"{self.tag}_config_journal",
+                user_data="journal",
+            )
             # NOTE intentionally not exposed as I don't want to deal with updating it at runtime
             # dpg.add_input_int(
             #     label="Undo History",
@@ -813,6 +1178,24 @@ class BehaviorEditor:
                     show=False,
                 )
 
+    def _regenerate_workspace_menu(self) -> None:
+        group = f"{self.tag}_menu_workspace_behaviors"
+        dpg.delete_item(group, children_only=True)
+
+        if not len(self.workspace):
+            dpg.add_text("No behaviors loaded", color=style.light_blue, parent=group)
+            return
+
+        for entry in self.workspace:
+            dpg.add_menu_item(
+                label=entry.name,
+                check=True,
+                default_value=entry is self.workspace.active,
+                callback=lambda s, a, u: self.switch_behavior(u),
+                user_data=entry,
+                parent=group,
+            )
+
     def _reload_templates(self) -> None:
         menu = f"{self.tag}_menu_templates"
         dpg.delete_item(menu, children_only=True)
@@ -850,6 +1233,8 @@ class BehaviorEditor:
         if dpg.is_key_down(dpg.mvKey_ModShift) and dpg.is_key_down(dpg.mvKey_ModCtrl):
             if key == dpg.mvKey_S:
                 self.file_save_as()
+            elif key == dpg.mvKey_F:
+                self.open_workspace_search_dialog()
 
         elif dpg.is_key_down(dpg.mvKey_ModCtrl):
             if key == dpg.mvKey_O:
@@ -1680,8 +2065,20 @@ class BehaviorEditor:
                 root = None
 
         if not root:
-            # Find the (first) statemachine the object appears in
-            root = self.get_active_statemachine(object_id)
+            # Find the closest statemachine on the object's path from the behavior root
+            sm_type = self.beh.type_registry.find_first_type_by_name("hkbStateMachine")
+            root = next(
+                (
+                    self.beh.objects[oid]
+                    for oid in reversed(self.beh.get_root_path_ids(object_id))
+                    if self.beh.objects[oid].type_id == sm_type
+                ),
+                None,
+            )
+
+            if not root:
+                # Object is not reachable from the behavior root, search its parents
+                root = self.get_active_statemachine(object_id)
 
             if not root:
                 self.logger.info("Object %s is not part of any statemachine", object_id)
@@ -1926,6 +2323,38 @@ class BehaviorEditor:
             tag=tag,
         )
 
+    def open_workspace_search_dialog(self, query: str = ""):
+        tag = f"{self.tag}_workspace_search_dialog"
+        if dpg.does_item_exist(tag):
+            dpg.show_item(tag)
+            dpg.focus_item(tag)
+            return
+
+        def activate(record: HkbRecord) -> bool:
+            entry = self.workspace.get_entry(record.tagfile)
+            if not entry:
+                self.logger.warning("The behavior is no longer part of the workspace")
+                return False
+
+            self.switch_behavior(entry)
+            return True
+
+        def on_pin(sender: str, record: HkbRecord, user_data: Any) -> None:
+            if activate(record):
+                self.add_pinned_object(record.object_id)
+
+        def on_jump(sender: str, record: HkbRecord, user_data: Any) -> None:
+            if activate(record):
+                self.jump_to_object(record.object_id)
+
+        search_workspace_dialog(
+            self.workspace,
+            pin_callback=on_pin,
+            jump_callback=on_jump,
+            initial_filter=query,
+            tag=tag,
+        )
+
     def open_mass_rename_dialog(self, node: Node) -> None:
         tag = f"{self.tag}_mass_rename_dialog_{node.id}"
         if dpg.does_item_exist(tag):
@@ -1951,7 +2380,7 @@ class BehaviorEditor:
         if dpg.does_item_exist(tag):
             # TODO just for testing
             graphmap: GraphMap = dpg.get_item_user_data(tag)
-            graphmap.set_graph(self.canvas.graph)
+            graphmap.set_graph(self.canvas.graph, self.beh.file + ".graphmap.npz")
             dpg.show_item(tag)
             # dpg.focus_item(tag)
             return
@@ -1973,7 +2402,11 @@ class BehaviorEditor:
         ) as dialog:
             g = self.canvas.graph
             graph_map = GraphMap(
-                g, self.get_node_frontpage, on_graphnode_selected, tag + "_content"
+                g,
+                self.get_node_frontpage,
+                on_graphnode_selected,
+                tag + "_content",
+                cache_file=self.beh.file + ".graphmap.npz",
             )
 
         dpg.set_item_user_data(dialog, graph_map)
@@ -1985,7 +2418,27 @@ class BehaviorEditor:
             dpg.focus_item(tag)
             return
 
-        eventlistener_dialog(tag=tag)
+        # States highlighted for the previously received events
+        highlighted: list[str] = []
+
+        def on_transitions(transitions: list[EventTransition]) -> None:
+            selected = self.canvas.selected_node
+            selected_id = selected.id if selected else None
+
+            for node_id in highlighted:
+                if node_id != selected_id:
+                    self.canvas.set_highlight(node_id, style.white)
+
+            highlighted.clear()
+            for transition in transitions:
+                target = transition.target_state_id
+                if target and target != selected_id:
+                    self.canvas.set_highlight(target, style.yellow)
+                    highlighted.append(target)
+
+        eventlistener_dialog(
+            behavior=self.beh, on_transitions=on_transitions, tag=tag
+        )
 
     def open_stategraph_dialog(self):
         tag = f"{self.tag}_state_graph_dialog"
@@ -2140,6 +2593,26 @@ class BehaviorEditor:
 
         fix_common_problems_dialog(self.beh, tag=tag)
 
+    def open_deduplicate_dialog(self):
+        tag = f"{self.tag}_deduplicate"
+        if dpg.does_item_exist(tag):
+            dpg.show_item(tag)
+            dpg.focus_item(tag)
+            return
+
+        def on_merged(sender: str, removed: int, user_data: Any) -> None:
+            if not removed:
+                return
+
+            for oid in self.get_pinned_objects():
+                if oid not in self.beh.objects:
+                    self.remove_pinned_object(oid)
+
+            self.regenerate()
+            self.attributes_widget.regenerate()
+
+        deduplicate_dialog(self.beh, on_merged, tag=tag)
+
     def open_hierarchy_import_dialog(self):
         file_path = open_file_dialog(
             title="Select Hierarchy", filetypes={"Hierarchy": "*.xml"}
@@ -2151,22 +2624,129 @@ class BehaviorEditor:
         with open(file_path) as f:
             xml = f.read()
 
-        def on_import(hierarchy):
-            new_objects = [
-                r.result
-                for r in hierarchy.objects.values()
-                if r.action == MergeAction.NEW
-            ]
-            self.logger.info(f"Imported hierarchy of {len(new_objects)} elements")
+        import_hierarchy(self.beh, xml, self._on_hierarchy_imported)
 
-            if hierarchy.pin_objects:
-                for obj in new_objects:
-                    self.add_pinned_object(obj)
+    def open_workspace_hierarchy_import_dialog(self):
+        others = [e for e in self.workspace if e is not self.workspace.active]
+        if not others:
+            self.logger.warning(
+                "Add other behaviors to the workspace to import hierarchies from them"
+            )
+            return
 
-            self.regenerate()
-            self.jump_to_object(hierarchy.root_id)
+        def on_select(entry: WorkspaceEntry) -> None:
+            def do_import(sender: str, record: HkbRecord, user_data: Any) -> None:
+                if record is None:
+                    return
 
-        import_hierarchy(self.beh, xml, on_import)
+                # The source is already loaded and indexed, no need to go through a file
+                xml = copy_hierarchy(record)
+                import_hierarchy(self.beh, xml, self._on_hierarchy_imported)
+
+            select_object(
+                entry.behavior,
+                None,
+                do_import,
+                allow_clear=False,
+                title=f"Select Hierarchy Root ({entry.name})",
+            )
+
+        if len(others) == 1:
+            on_select(others[0])
+            return
+
+        def on_entry_selected(sender: str, app_data: Any, entry: WorkspaceEntry):
+            dpg.delete_item(popup)
+            on_select(entry)
+
+        with dpg.window(
+            label="Import From",
+            popup=True,
+            autosize=True,
+            no_saved_settings=True,
+            on_close=lambda: dpg.delete_item(popup),
+        ) as popup:
+            for entry in others:
+                dpg.add_selectable(
+                    label=entry.name, callback=on_entry_selected, user_data=entry
+                )
+
+        dpg.set_item_pos(popup, dpg.get_mouse_pos(local=False))
+
+    def _on_hierarchy_imported(self, hierarchy) -> None:
+        new_objects = [
+            r.result for r in hierarchy.objects.values() if r.action == MergeAction.NEW
+        ]
+        self.logger.info(f"Imported hierarchy of {len(new_objects)} elements")
+
+        if hierarchy.pin_objects:
+            for obj in new_objects:
+                self.add_pinned_object(obj)
+
+        self.regenerate()
+        self.jump_to_object(hierarchy.root_id)
+
+    def open_hierarchy_export_dialog(self):
+        if not self.selected_node:
+            self.logger.warning("Select the root node of the hierarchy to export first")
+            return
+
+        record = self.beh.objects.get(self.selected_node.id)
+        if not record:
+            return
+
+        name = record.get_field("name", None, resolve=True) or record.object_id
+        file_path = save_file_dialog(
+            title="Export Hierarchy",
+            default_file=f"{name}.xml",
+            filetypes={"Hierarchy": "*.xml"},
+        )
+
+        if not file_path:
+            return
+
+        loading = common_loading_indicator("Exporting")
+        try:
+            write_hierarchies([(record, file_path)])
+            self.logger.info(f"Exported hierarchy of {record} to {file_path}")
+        finally:
+            dpg.delete_item(loading)
+
+    def open_pinned_hierarchies_export_dialog(self):
+        records = [
+            self.beh.objects[oid]
+            for oid in self.get_pinned_objects()
+            if oid in self.beh.objects
+        ]
+        if not records:
+            self.logger.warning("Pin the root nodes of the hierarchies to export first")
+            return
+
+        folder = choose_folder(
+            title="Export Pinned Hierarchies",
+            start_dir=os.path.dirname(self.loaded_file or ""),
+        )
+        if not folder:
+            return
+
+        items = []
+        used_names = set()
+        for record in records:
+            name = record.get_field("name", None, resolve=True) or record.object_id
+            if name in used_names:
+                # Several objects may share a name, but each needs its own file
+                name = f"{name}_{record.object_id}"
+
+            used_names.add(name)
+            items.append((record, os.path.join(folder, f"{name}.xml")))
+
+        loading = common_loading_indicator("Exporting")
+        try:
+            # The behavior graph is only explored once for all hierarchies
+            write_hierarchies(items)
+            self.logger.info(f"Exported {len(items)} hierarchies to {folder}")
+        finally:
+            dpg.delete_item(loading)
 
     def open_mirror_skeleton_dialog(self):
         tag = f"{self.tag}_bone_mirror_dialog"
@@ -2177,6 +2757,27 @@ class BehaviorEditor:
 
         skeleton_mirror_dialog(self.loaded_skeleton_path, tag=tag)
 
+    def open_memory_report_dialog(self):
+        tag = f"{self.tag}_memory_report_dialog"
+        if dpg.does_item_exist(tag):
+            dpg.delete_item(tag)
+
+        # Only the xml trees of other behaviors are measured
+        others = [e.behavior._tree for e in self.workspace if e.behavior is not self.beh]
+
+        loading = common_loading_indicator("Measuring")
+        try:
+            memory_report_dialog(
+                self.beh,
+                extra={
+                    "gui": [self.canvas, self.attributes_widget, self.alias_manager],
+                    "other behaviors": others,
+                },
+                tag=tag,
+            )
+        finally:
+            dpg.delete_item(loading)
+
     def verify_behavior(self):
         if self._busy:
             return
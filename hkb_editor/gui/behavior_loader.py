@@ -0,0 +1,168 @@
+from typing import Callable
+from threading import Thread
+import os
+import shutil
+import time
+import logging
+
+from hkb_editor.hkb.behavior import HavokBehavior
+from hkb_editor.hkb.version_updates import fix_variable_defaults
+from hkb_editor.external import hkx_to_xml, unpack_binder
+
+
+class LoadingCancelled(Exception):
+    pass
+
+
+class BehaviorLoader:
+    """Loads a behavior in a background thread, reporting the progress of each loading stage.
+
+    All callbacks are called from the worker thread. Callers that need to update the UI should defer their work to the main thread, e.g. using `dpg.set_frame_callback`.
+
+    Parameters
+    ----------
+    file_path : str
+        The file to load. HKX files and behavior binders are converted to XML first.
+    on_stage : Callable[[str], None], optional
+        Called with the name of each stage (see `stages`) before it starts.
+    on_done : Callable[[HavokBehavior], None], optional
+        Called with the loaded behavior once all stages have finished.
+    on_error : Callable[[Exception], None], optional
+        Called if loading fails. Not called when loading was cancelled.
+    session_backup : bool, optional
+        Whether to save a copy of the behavior that won't be overwritten on save.
+    migrations : bool, optional
+        Whether to fix problems left by previous versions. Should be disabled for files the editor wrote itself, e.g. snapshots.
+    """
+
+    stages = (
+        "convert",
+        "parse",
+        "types",
+        "objects",
+        "name arrays",
+        "graph",
+        "backup",
+        "migrations",
+    )
+
+    def __init__(
+        self,
+        file_path: str,
+        *,
+        on_stage: Callable[[str], None] = None,
+        on_done: Callable[[HavokBehavior], None] = None,
+        on_error: Callable[[Exception], None] = None,
+        session_backup: bool = False,
+        migrations: bool = True,
+    ):
+        self.file_path = file_path
+        self.on_stage = on_stage
+        self.on_done = on_done
+        self.on_error = on_error
+        self.session_backup = session_backup
+        self.migrations = migrations
+
+        self.logger = logging.getLogger(self.__class__.__name__)
+        # Seconds spent in each finished stage
+        self.timings: dict[str, float] = {}
+        self.current_stage: str = None
+        self._stage_start = 0.0
+        self._cancelled = False
+        self._thread: Thread = None
+
+    @property
+    def cancelled(self) -> bool:
+        return self._cancelled
+
+    @property
+    def running(self) -> bool:
+        return self._thread is not None and self._thread.is_alive()
+
+    def start(self) -> None:
+        if self._thread:
+            return
+
+        self._thread = Thread(target=self._run, daemon=True)
+        self._thread.start()
+
+    def cancel(self) -> None:
+        """Abort loading at the start of the next stage. Conversions by external tools will still run to completion, but their result is discarded."""
+        self._cancelled = True
+
+    def _enter_stage(self, stage: str) -> None:
+        now = time.perf_counter()
+        if self.current_stage:
+            self.timings[self.current_stage] = now - self._stage_start
+
+        if self._cancelled:
+            raise LoadingCancelled()
+
+        self.current_stage = stage
+        self._stage_start = now
+
+        if stage:
+            self.logger.debug("Loading stage: %s", stage)
+            if self.on_stage:
+                self.on_stage(stage)
+
+    def load(self) -> HavokBehavior:
+        """Load the behavior in the calling thread, e.g. when loading several behaviors from a thread pool.
+
+        Returns
+        -------
+        HavokBehavior
+            The loaded behavior.
+
+        Raises
+        ------
+        LoadingCancelled
+            If loading was cancelled.
+        """
+        file_path = self.file_path
+
+        self._enter_stage("convert")
+        if file_path.lower().endswith(".hkx"):
+            self.logger.info("Converting HKX to XML...")
+            file_path = hkx_to_xml(file_path)
+        elif file_path.lower().endswith(".behbnd.dcx"):
+            self.logger.info("Opening binder...")
+            file_path = unpack_binder(file_path)
+
+        # Enters the stages from parse to graph
+        beh = HavokBehavior(file_path, undo=True, progress=self._enter_stage)
+
+        self._enter_stage("backup")
+        if self.session_backup:
+            shutil.copy(beh.file, beh.file + ".session_backup")
+
+        # Fix anything that was amiss in previous versions
+        self._enter_stage("migrations")
+        if self.migrations:
+            fix_variable_defaults(beh)
+
+        self._enter_stage(None)
+
+        total = sum(self.timings.values())
+        self.logger.debug(
+            "Loaded %s in %.2fs (%s)",
+            file_path,
+            total,
+            ", ".join(f"{k}: {v:.2f}s" for k, v in self.timings.items()),
+        )
+
+        return beh
+
+    def _run(self) -> None:
+        try:
+            beh = self.load()
+        except LoadingCancelled:
+            self.logger.info("Loading %s cancelled", os.path.basename(self.file_path))
+            return
+        except Exception as e:
+            if self.on_error:
+                self.on_error(e)
+            return
+
+        if self.on_done:
+            self.on_done(beh)
@@ -1,9 +1,15 @@
 from .about import about_dialog
-from .file_dialog import open_file_dialog, save_file_dialog
+from .file_dialog import (
+    open_file_dialog,
+    open_multiple_dialog,
+    save_file_dialog,
+    choose_folder,
+)
 from .edit_simple_array import edit_simple_array_dialog
 from .find_object import (
     find_dialog,
     search_objects_dialog,
+    search_workspace_dialog,
     select_object,
     select_variable,
     select_event,
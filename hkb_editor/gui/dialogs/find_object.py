@@ -1,10 +1,12 @@
 from typing import Any, Callable, Iterable, Generator
+import os
 import webbrowser
 from dearpygui import dearpygui as dpg
 import time
 
 from hkb_editor.hkb.hkb_types import HkbRecord
 from hkb_editor.hkb.behavior import HavokBehavior, HkbVariable
+from hkb_editor.hkb.workspace import Workspace
 from hkb_editor.hkb.query import query_objects, lucene_help_text, lucene_url
 from hkb_editor.gui.helpers import make_copy_menu, table_sort, add_paragraphs
 from hkb_editor.gui import style
@@ -366,6 +368,61 @@ def search_objects_dialog(
     )
 
 
+def search_workspace_dialog(
+    workspace: Workspace,
+    pin_callback: Callable[[str, HkbRecord, Any], None] = None,
+    jump_callback: Callable[[str, HkbRecord, Any], None] = None,
+    *,
+    initial_filter: str = "",
+    tag: str = None,
+    user_data: Any = None,
+) -> str:
+    if tag in (None, "", 0):
+        tag = dpg.generate_uuid()
+
+    def item_to_row(item: HkbRecord):
+        name = item.get_field("name", "", resolve=True)
+        type_name = item.tagfile.type_registry.get_name(item.type_id)
+        return (os.path.basename(item.tagfile.file), item.object_id, name, type_name)
+
+    def make_context_menu(item: HkbRecord):
+        with dpg.window(
+            popup=True,
+            min_size=(100, 20),
+            no_saved_settings=True,
+            autosize=True,
+            on_close=lambda: dpg.delete_item(popup),
+        ) as popup:
+            if pin_callback:
+                dpg.add_selectable(
+                    label="Pin",
+                    callback=lambda: pin_callback(tag, item, user_data),
+                )
+            if jump_callback:
+                dpg.add_selectable(
+                    label="Jump To",
+                    callback=lambda: jump_callback(tag, item, user_data),
+                )
+            make_copy_menu(item)
+
+        dpg.set_item_pos(popup, dpg.get_mouse_pos(local=False))
+
+    return find_dialog(
+        workspace.query,
+        ["File", "ID", "Name", "Type"],
+        item_to_row,
+        context_menu_func=make_context_menu,
+        okay_callback=None,
+        initial_filter=initial_filter,
+        filter_help=lucene_help_text,
+        hide_on_close=True,
+        on_filter_help_click=lambda: webbrowser.open(lucene_url),
+        title="Find in Workspace...",
+        tag=tag,
+        user_data=user_data,
+    )
+
+
 def select_object(
     behavior: HavokBehavior,
     target_type_id: str,
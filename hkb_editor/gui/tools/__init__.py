@@ -1,3 +1,4 @@
 from .mirror_skeleton import skeleton_mirror_dialog
 from .event_listener import eventlistener_dialog
-from .state_graph_viewer import open_state_graph_viewer
\ No newline at end of file
+from .state_graph_viewer import open_state_graph_viewer
+from .memory_report import memory_report_dialog
@@ -0,0 +1,311 @@
+from typing import Callable, TYPE_CHECKING
+import math
+import struct
+import threading
+import time
+import numpy as np
+
+if TYPE_CHECKING:
+    from hkb_editor.gui.tools.event_listener import EventRingBuffer
+
+
+# Captures consist of a 16 byte header followed by 16 byte records. Event records hold
+# a timestamp and the interned ids of the character and event name. Names are defined
+# inline the first time they are used: a record with a NaN timestamp holds the name's
+# id and length and is followed by the name's bytes, padded to full records.
+_magic = b"HKBEVT\x01\x00"
+_header_size = 16
+_record = struct.Struct("<dII")
+_record_dtype = np.dtype([("t", "<f8"), ("a", "<u4"), ("b", "<u4")])
+_nan = float("nan")
+
+
+def split_message(message: str) -> tuple[str, str]:
+    """Split a message from the event listener into character and event name.
+
+    Parameters
+    ----------
+    message : str
+        The received message, usually of the form `<character>:<event>`.
+
+    Returns
+    -------
+    tuple[str, str]
+        The character (or an empty string if there is none) and the event name.
+    """
+    character, sep, event = message.partition(":")
+    if not sep:
+        return ("", message)
+
+    return (character, event)
+
+
+class EventCaptureWriter:
+    """Append-only writer for event captures. Safe to use from several threads.
+
+    Parameters
+    ----------
+    file_path : str
+        The file to write. Will be overwritten if it exists.
+    """
+
+    def __init__(self, file_path: str):
+        self.file_path = file_path
+        self.count = 0
+        self._file = open(file_path, "wb")
+        self._file.write(_magic.ljust(_header_size, b"\x00"))
+        self._name_ids: dict[str, int] = {}
+        self._lock = threading.Lock()
+
+    def _intern(self, name: str) -> int:
+        nid = self._name_ids.get(name)
+        if nid is None:
+            nid = len(self._name_ids)
+            self._name_ids[name] = nid
+
+            data = name.encode("utf-8")
+            num_records = math.ceil(len(data) / _record.size)
+            self._file.write(_record.pack(_nan, nid, len(data)))
+            self._file.write(data.ljust(num_records * _record.size, b"\x00"))
+
+        return nid
+
+    def write(self, timestamp: float, message: str) -> None:
+        """Append an event to the capture.
+
+        Parameters
+        ----------
+        timestamp : float
+            When the event was received. Must not decrease.
+        message : str
+            The message as received by the event listener.
+        """
+        character, event = split_message(message)
+
+        with self._lock:
+            if self._file is None:
+                return
+
+            character_id = self._intern(character)
+            event_id = self._intern(event)
+            self._file.write(_record.pack(timestamp, character_id, event_id))
+            self.count += 1
+
+    def close(self) -> None:
+        with self._lock:
+            if self._file is not None:
+                self._file.close()
+                self._file = None
+
+    def __enter__(self) -> "EventCaptureWriter":
+        return self
+
+    def __exit__(self, *args) -> None:
+        self.close()
+
+
+class EventCapture:
+    """A recorded event capture loaded into memory.
+
+    Parameters
+    ----------
+    file_path : str
+        The capture file to load. Incomplete records at the end of the file (e.g. from a crash while recording) are ignored.
+    """
+
+    def __init__(self, file_path: str):
+        self.file_path = file_path
+
+        with open(file_path, "rb") as f:
+            data = f.read()
+
+        if not data.startswith(_magic):
+            raise ValueError(f"{file_path} is not an event capture")
+
+        num_records = (len(data) - _header_size) // _record.size
+        records = np.frombuffer(
+            data, dtype=_record_dtype, count=num_records, offset=_header_size
+        )
+
+        self.names: list[str] = []
+        is_event = np.ones(num_records, dtype=bool)
+        skip_until = 0
+
+        # Name definitions are rare, so it's fine to handle them one by one
+        for pos in np.flatnonzero(np.isnan(records["t"])):
+            if pos < skip_until:
+                # Part of a name's bytes
+                continue
+
+            nid = int(records["a"][pos])
+            length = int(records["b"][pos])
+            skip_until = pos + 1 + math.ceil(length / _record.size)
+            is_event[pos:skip_until] = False
+
+            start = _header_size + (pos + 1) * _record.size
+            name = data[start : start + length].decode("utf-8", errors="replace")
+            if nid >= len(self.names):
+                self.names.extend([""] * (nid + 1 - len(self.names)))
+            self.names[nid] = name
+
+        events = records[is_event]
+
+        self.times = events["t"].copy()
+        self.characters = events["a"].astype(np.int32)
+        self.event_ids = events["b"].astype(np.int32)
+
+        # Combined messages as they were received, interned per character and event
+        num_names = max(len(self.names), 1)
+        pairs = self.characters.astype(np.int64) * num_names + self.event_ids
+        unique_pairs, message_ids = np.unique(pairs, return_inverse=True)
+        self.message_ids = message_ids.reshape(-1).astype(np.int32)
+        self.messages = [
+            self._format_message(int(p) // num_names, int(p) % num_names)
+            for p in unique_pairs
+        ]
+
+    def _format_message(self, character: int, event: int) -> str:
+        if not self.names[character]:
+            return self.names[event]
+
+        return f"{self.names[character]}:{self.names[event]}"
+
+    def __len__(self) -> int:
+        return len(self.times)
+
+    @property
+    def start_time(self) -> float:
+        return float(self.times[0]) if len(self.times) else 0.0
+
+    @property
+    def duration(self) -> float:
+        if not len(self.times):
+            return 0.0
+
+        return float(self.times[-1] - self.times[0])
+
+    def get_message(self, idx: int) -> str:
+        return self.messages[self.message_ids[idx]]
+
+    def seek(self, offset: float) -> int:
+        """Find the first event at or after the specified time.
+
+        Parameters
+        ----------
+        offset : float
+            Time relative to the start of the capture.
+
+        Returns
+        -------
+        int
+            Index of the event, or the number of events if there is none.
+        """
+        return int(np.searchsorted(self.times, self.start_time + offset, side="left"))
+
+
+class CaptureReplay:
+    """Replays a capture into an event buffer in a background thread, optionally faster than real time.
+
+    Parameters
+    ----------
+    capture : EventCapture
+        The capture to replay.
+    events : EventRingBuffer
+        Receives the replayed events. The replay will be its only writer.
+    clock : Callable[[], float], optional
+        Provides the timestamps of the replayed events.
+    speed : float, optional
+        Playback speed relative to the original recording.
+    """
+
+    def __init__(
+        self,
+        capture: EventCapture,
+        events: "EventRingBuffer",
+        clock: Callable[[], float] = time.perf_counter,
+        speed: float = 1.0,
+    ):
+        self.capture = capture
+        self.events = events
+        self.clock = clock
+        self.speed = speed
+        # Current time relative to the start of the capture
+        self.position = 0.0
+
+        self._seek_request: float = 0.0
+        self._running = False
+        self._thread: threading.Thread = None
+
+    @property
+    def finished(self) -> bool:
+        return self.position >= self.capture.duration
+
+    def seek(self, offset: float) -> None:
+        """Continue the replay from the specified time.
+
+        Parameters
+        ----------
+        offset : float
+            Time relative to the start of the capture.
+        """
+        self._seek_request = min(max(0.0, offset), self.capture.duration)
+
+    def start(self) -> None:
+        if self._running:
+            return
+
+        self._running = True
+        self._thread = threading.Thread(target=self._run, daemon=True)
+        self._thread.start()
+
+    def stop(self) -> None:
+        self._running = False
+        if self._thread:
+            self._thread.join(timeout=0.5)
+            self._thread = None
+
+    def _run(self) -> None:
+        capture = self.capture
+        times = capture.times
+        start_time = capture.start_time
+
+        idx = 0
+        speed = self.speed
+        base_clock = self.clock()
+        base_offset = 0.0
+        last_timestamp = -math.inf
+
+        while self._running:
+            now = self.clock()
+
+            seek_to = self._seek_request
+            if seek_to is not None:
+                self._seek_request = None
+                idx = capture.seek(seek_to)
+                base_clock = now
+                base_offset = seek_to
+
+            if self.speed != speed:
+                # Continue from the current position at the new speed
+                base_offset += (now - base_clock) * speed
+                base_clock = now
+                speed = self.speed
+
+            offset = base_offset + (now - base_clock) * speed
+            end = int(np.searchsorted(times, start_time + offset, side="right"))
+
+            if end > idx:
+                # Spread the events as they would have arrived since the last step
+                event_offsets = times[idx:end] - start_time
+                timestamps = now - (offset - event_offsets) / speed
+                # Seeking backwards must not move timestamps back in time
+                np.maximum(timestamps, last_timestamp, out=timestamps)
+                last_timestamp = timestamps[-1]
+
+                self.events.extend(
+                    timestamps, capture.message_ids[idx:end], capture.messages
+                )
+                idx = end
+
+            self.position = min(offset, capture.duration)
+            time.sleep(0.005)
@@ -1,69 +1,343 @@
 #!/usr/bin/env python3
-from typing import Any
+from typing import Any, Callable
+import logging
 import socket
 import threading
 import colorsys
 import re
+import time
+import numpy as np
 from dearpygui import dearpygui as dpg
-from collections import deque
 
+from hkb_editor.hkb import HavokBehavior
+from hkb_editor.hkb.transition_index import TransitionIndex, EventTransition
 from hkb_editor.gui.helpers import add_paragraphs
+from hkb_editor.gui.dialogs import open_file_dialog, save_file_dialog
 from hkb_editor.gui import style
-
-
-def eventlistener_dialog(*, tag: str = 0) -> str:
+from .event_capture import (
+    EventCaptureWriter,
+    EventCapture,
+    CaptureReplay,
+    split_message,
+)
+
+
+class EventRingBuffer:
+    """Fixed-capacity buffer of timestamped events. Once full, the oldest events are overwritten.
+
+    Event names are interned, so each event only takes up a timestamp and an integer id. The buffer is safe to use without locks as long as there is only a single writer: the writer announces which entries it is about to overwrite before touching them, and readers discard any entries that were (or may have been) overwritten while they were reading.
+
+    Parameters
+    ----------
+    capacity : int, optional
+        Maximum number of events to keep.
+    """
+
+    def __init__(self, capacity: int = 1 << 16):
+        self.capacity = capacity
+        self.times = np.zeros(capacity, dtype=np.float64)
+        self.event_ids = np.zeros(capacity, dtype=np.int32)
+        # Index of the interned event names
+        self.names: list[str] = []
+        self._name_ids: dict[str, int] = {}
+        # Total number of events written, only ever modified by the writer
+        self.count = 0
+        # Events up to this index are being written right now. Published before any
+        # slot is touched, so readers know which entries may be torn
+        self.writing = 0
+
+    def intern(self, name: str) -> int:
+        eid = self._name_ids.get(name)
+        if eid is None:
+            eid = len(self.names)
+            # Append the name before publishing its id so readers can always look it up
+            self.names.append(name)
+            self._name_ids[name] = eid
+
+        return eid
+
+    def push(self, timestamp: float, name: str) -> None:
+        """Add an event. Timestamps must not decrease.
+
+        Parameters
+        ----------
+        timestamp : float
+            When the event was received.
+        name : str
+            Name of the event.
+        """
+        idx = self.count % self.capacity
+        self.writing = self.count + 1
+        self.times[idx] = timestamp
+        self.event_ids[idx] = self.intern(name)
+        # Publish the entry only after it has been written
+        self.count += 1
+
+    def extend(
+        self, timestamps: np.ndarray, message_ids: np.ndarray, messages: list[str]
+    ) -> None:
+        """Add several events at once.
+
+        Parameters
+        ----------
+        timestamps : np.ndarray
+            When the events were received. Must not decrease.
+        message_ids : np.ndarray
+            Index of each event's name in `messages`.
+        messages : list[str]
+            Event names referenced by `message_ids`.
+        """
+        used = np.unique(message_ids)
+        lookup = np.zeros(len(messages), dtype=np.int32)
+        lookup[used] = [self.intern(messages[i]) for i in used]
+
+        # Only the most recent events would survive anyway
+        timestamps = timestamps[-self.capacity :]
+        message_ids = message_ids[-self.capacity :]
+
+        self.writing = self.count + len(timestamps)
+        positions = (self.count + np.arange(len(timestamps))) % self.capacity
+        self.times[positions] = timestamps
+        self.event_ids[positions] = lookup[message_ids]
+        self.count += len(timestamps)
+
+    def get_range(self, t_min: float) -> tuple[np.ndarray, np.ndarray]:
+        """Get all buffered events received at or after the specified time.
+
+        Parameters
+        ----------
+        t_min : float
+            Earliest timestamp to include.
+
+        Returns
+        -------
+        tuple[np.ndarray, np.ndarray]
+            Timestamps and interned ids of the events in chronological order.
+        """
+        end = self.count
+        start = max(0, end - self.capacity)
+        head = start % self.capacity
+        tail = end % self.capacity or self.capacity
+
+        if end == start:
+            return self.times[:0], self.event_ids[:0]
+
+        if head < tail:
+            times = self.times[head:tail].copy()
+            event_ids = self.event_ids[head:tail].copy()
+        else:
+            times = np.concatenate((self.times[head:], self.times[:tail]))
+            event_ids = np.concatenate((self.event_ids[head:], self.event_ids[:tail]))
+
+        # Discard entries the writer overwrote (or is overwriting) while we were copying
+        overwritten = self.writing - self.capacity - start
+        first = max(overwritten, 0)
+        first = max(first, int(np.searchsorted(times[first:], t_min)) + first)
+
+        return times[first:], event_ids[first:]
+
+
+def receive_events(
+    sock: socket.socket,
+    events: EventRingBuffer,
+    is_running: Callable[[], bool],
+    clock: Callable[[], float] = time.perf_counter,
+    on_event: Callable[[float, str], None] = None,
+) -> None:
+    """Receive events over UDP and add them to a buffer until stopped.
+
+    Parameters
+    ----------
+    sock : socket.socket
+        A bound datagram socket. It should have a timeout so that stopping is noticed.
+    events : EventRingBuffer
+        Buffer to add the received events to.
+    is_running : Callable[[], bool]
+        Called regularly to check whether to keep listening.
+    clock : Callable[[], float], optional
+        Provides the timestamps of received events.
+    on_event : Callable[[float, str], None], optional
+        Called with the timestamp and message of every received event.
+    """
+    recv = sock.recv
+    push = events.push
+
+    while is_running():
+        try:
+            data = recv(1024)
+        except socket.timeout:
+            continue
+        except OSError:
+            break
+
+        timestamp = clock()
+        message = data.decode("utf-8", errors="replace").strip()
+        push(timestamp, message)
+
+        if on_event:
+            on_event(timestamp, message)
+
+
+def eventlistener_dialog(
+    *,
+    behavior: HavokBehavior = None,
+    on_transitions: Callable[[list[EventTransition]], None] = None,
+    tag: str = 0,
+) -> str:
+    """Open a window that plots the events received from the game over UDP.
+
+    Parameters
+    ----------
+    behavior : HavokBehavior, optional
+        If provided, received events are resolved to the transitions they trigger in this behavior. Events from other characters are ignored.
+    on_transitions : Callable[[list[EventTransition]], None], optional
+        Called once per frame with the transitions triggered by the events received since the previous frame.
+    tag : str, optional
+        Tag of the window.
+
+    Returns
+    -------
+    str
+        Tag of the window.
+    """
     if tag in (0, "", None):
         tag = dpg.generate_uuid()
 
+    start_time = time.perf_counter()
     plot_t = 0.0
+    # Events before this are not shown anymore
+    clear_t = 0.0
     port = 27072
     time_range = 10
     max_events = 100
     num_rows = 10
-    event_idx = 0
-    row_assignments = {}
-    events = deque(maxlen=max_events)
+    live_events = EventRingBuffer()
+    # The buffer that is currently displayed, either live or replayed events
+    events = live_events
+    recorder: EventCaptureWriter = None
+    replay: CaptureReplay = None
     sock = None
     listener_thread = None
     running = True
     paused = False
 
+    # Per interned event id, updated whenever new events arrive or the filter changes
+    label_filter = None
+    label_show_chr = None
+    label_rows = np.zeros(0, dtype=np.int32)
+    label_visible = np.zeros(0, dtype=bool)
+    label_texts: list[str] = []
+    label_colors: list[tuple[int, int, int]] = []
+    label_widths: list[float] = []
+    row_assignments: dict[str, int] = {}
+
+    # Draw items are reused instead of creating new ones for every event
+    num_markers = 0
+
+    # Transitions triggered by each interned event id of the displayed buffer
+    transition_index = TransitionIndex(behavior) if behavior else None
+    behavior_chr = behavior.get_character_id() if behavior else None
+    transition_cache: list[tuple[EventTransition, ...]] = []
+    # Events up to and including this time have been resolved already
+    resolved_t = 0.0
+    plot_height = -80 if behavior else -57
+
+    def get_time() -> float:
+        return time.perf_counter() - start_time
+
     def socket_listener():
-        nonlocal sock, event_idx
+        nonlocal sock
         sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        # Give the OS some room to buffer bursts while the GIL is busy elsewhere
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 1 << 20)
         sock.settimeout(0.1)
         sock.bind(("localhost", port))
 
         try:
-            while running:
-                try:
-                    data, _ = sock.recvfrom(1024)
-                    event = data.decode("utf-8").strip()
-                    filter_value = dpg.get_value(f"{tag}_filter").strip()
-
-                    if not filter_value or (
-                        filter_value in event
-                        or re.match(filter_value, event, flags=re.IGNORECASE)
-                    ):
-                        print(f" ✦ {event}")
-
-                        if not dpg.get_value(f"{tag}_show_chr"):
-                            event = event.split(":", maxsplit=1)[-1]
-
-                        row = row_assignments.setdefault(
-                            event, (len(row_assignments) + 1) % num_rows
-                        )
-
-                        eid = event_idx
-                        event_idx += 1
-                        events.append((eid, plot_t, row, event))
-                except socket.timeout:
-                    continue
-                except Exception:
-                    break
+            receive_events(
+                sock, live_events, lambda: running, get_time, record_event
+            )
         finally:
             sock.close()
 
+    def record_event(timestamp: float, message: str) -> None:
+        if recorder:
+            recorder.write(timestamp, message)
+
+    def toggle_recording(sender: str):
+        nonlocal recorder
+        if recorder:
+            rec = recorder
+            recorder = None
+            rec.close()
+            dpg.configure_item(sender, label="Record")
+            return
+
+        file_path = save_file_dialog(
+            title="Save Event Capture",
+            default_file="events.hkbevt",
+            filetypes={"Event Capture": "*.hkbevt"},
+        )
+        if not file_path:
+            return
+
+        recorder = EventCaptureWriter(file_path)
+        dpg.configure_item(sender, label="Stop")
+
+    def start_replay():
+        nonlocal replay, events
+
+        file_path = open_file_dialog(
+            title="Select Event Capture",
+            filetypes={"Event Capture": "*.hkbevt"},
+        )
+        if not file_path:
+            return
+
+        try:
+            capture = EventCapture(file_path)
+        except (OSError, ValueError) as e:
+            logging.getLogger().error(f"Failed to load event capture: {e}")
+            return
+
+        stop_replay()
+
+        # The replay must be the only writer of the buffer it fills
+        events = EventRingBuffer()
+        replay = CaptureReplay(
+            capture, events, get_time, dpg.get_value(f"{tag}_replay_speed")
+        )
+        clear_events()
+        replay.start()
+
+        dpg.configure_item(
+            f"{tag}_replay_position", max_value=capture.duration, default_value=0.0
+        )
+        dpg.show_item(f"{tag}_replay_controls")
+        dpg.configure_item(f"{tag}_plot", height=plot_height - 27)
+
+    def stop_replay():
+        nonlocal replay, events
+        if not replay:
+            return
+
+        replay.stop()
+        replay = None
+        events = live_events
+        clear_events()
+
+        dpg.hide_item(f"{tag}_replay_controls")
+        dpg.configure_item(f"{tag}_plot", height=plot_height)
+
+    def seek_replay(sender: str, offset: float, user_data: Any):
+        if replay:
+            replay.seek(offset)
+            clear_events()
+
+    def set_replay_speed(sender: str, speed: int, user_data: Any):
+        if replay:
+            replay.speed = max(1, speed)
+
     def toggle_playback(sender: str):
         nonlocal paused
         paused = not paused
@@ -71,10 +345,15 @@ def eventlistener_dialog(*, tag: str = 0) -> str:
         dpg.configure_item(sender, label=label)
 
     def clear_events():
-        nonlocal plot_t
-        events.clear()
-        row_assignments.clear()
-        plot_t = 0.0
+        nonlocal clear_t, label_filter, num_markers, resolved_t, transition_cache
+        # Only the listener thread is allowed to modify the buffer
+        clear_t = get_time()
+        # Force the labels and rows to be reassigned
+        label_filter = None
+        num_markers = 0
+        # The displayed buffer may have changed, so its ids may refer to other events
+        resolved_t = clear_t
+        transition_cache = []
 
         dpg.delete_item(f"{tag}_series", children_only=True, slot=2)
 
@@ -103,101 +382,224 @@ def eventlistener_dialog(*, tag: str = 0) -> str:
         r, g, b = colorsys.hsv_to_rgb(h / 360, 0.8, 0.9)
         return (int(r * 255), int(g * 255), int(b * 255), 255)
 
+    def update_labels() -> None:
+        nonlocal label_filter, label_show_chr, label_rows, label_visible
+
+        filter_value = dpg.get_value(f"{tag}_filter").strip()
+        show_chr = dpg.get_value(f"{tag}_show_chr")
+        names = events.names[:]
+
+        if filter_value != label_filter or show_chr != label_show_chr:
+            label_filter = filter_value
+            label_show_chr = show_chr
+            label_texts.clear()
+            label_colors.clear()
+            label_widths.clear()
+            row_assignments.clear()
+            label_rows = np.zeros(0, dtype=np.int32)
+            label_visible = np.zeros(0, dtype=bool)
+
+        if len(label_texts) == len(names):
+            return
+
+        try:
+            pattern = re.compile(filter_value, flags=re.IGNORECASE)
+        except re.error:
+            pattern = None
+
+        new_rows = []
+        new_visible = []
+
+        # Only events we haven't seen before have to be evaluated
+        for name in names[len(label_texts) :]:
+            new_visible.append(
+                not filter_value
+                or filter_value in name
+                or bool(pattern and pattern.match(name))
+            )
+
+            if not show_chr:
+                name = name.split(":", maxsplit=1)[-1]
+
+            new_rows.append(
+                row_assignments.setdefault(name, (len(row_assignments) + 1) % num_rows)
+            )
+            label_texts.append(name)
+            label_colors.append(get_event_color(name)[:3])
+            label_widths.append(dpg.get_text_size(name)[0])
+
+        label_rows = np.concatenate((label_rows, new_rows)).astype(np.int32)
+        label_visible = np.concatenate((label_visible, new_visible)).astype(bool)
+
+    def get_visible_events() -> tuple[np.ndarray, np.ndarray]:
+        times, event_ids = events.get_range(max(plot_t - time_range * 2, clear_t))
+        update_labels()
+
+        # Ids may have been interned after we updated the labels
+        known = event_ids < len(label_visible)
+        times = times[known]
+        event_ids = event_ids[known]
+
+        mask = label_visible[event_ids]
+        times = times[mask][-max_events:]
+        event_ids = event_ids[mask][-max_events:]
+
+        return times, event_ids
+
+    def get_transition_label(transition: EventTransition) -> str:
+        target = behavior.objects.get(transition.target_state_id)
+        if target is None:
+            return f"<missing state> ({transition.transitions_id}:{transition.index})"
+
+        source = "*" if transition.is_wildcard else ""
+        return f"{source}{target['name'].get_value()}"
+
+    def resolve_transitions() -> None:
+        nonlocal resolved_t, transition_cache
+
+        if not transition_index:
+            return
+
+        if transition_index.is_outdated():
+            transition_index.rebuild()
+            transition_cache = []
+
+        times, event_ids = events.get_range(np.nextafter(resolved_t, np.inf))
+        if not len(times):
+            return
+
+        resolved_t = times[-1]
+
+        # Only events we haven't seen before have to be looked up
+        for name in events.names[len(transition_cache) :]:
+            character, event = split_message(name)
+            if character and behavior_chr and character != behavior_chr:
+                transition_cache.append(())
+            else:
+                transition_cache.append(transition_index.get_transitions(event))
+
+        # Ids may have been interned after we updated the cache
+        event_ids = event_ids[event_ids < len(transition_cache)]
+
+        # Resolve every distinct event once, ordered by when it was last received
+        unique_ids, last_seen = np.unique(event_ids[::-1], return_index=True)
+        unique_ids = unique_ids[np.argsort(-last_seen)]
+
+        triggered = []
+        last_eid = None
+        for eid in unique_ids:
+            transitions = transition_cache[eid]
+            if transitions:
+                triggered.extend(transitions)
+                last_eid = eid
+
+        if not triggered:
+            return
+
+        event = split_message(events.names[last_eid])[1]
+        targets = ", ".join(
+            get_transition_label(t) for t in transition_cache[last_eid]
+        )
+        dpg.set_value(f"{tag}_transitions", f"{event} -> {targets}")
+
+        if on_transitions:
+            on_transitions(triggered)
+
     # TODO there is an occasional annoying flicker that I couldn't track down so far
     def render_events(sender: str, app_data: list):
-        nonlocal plot_t
-        plot_t += dpg.get_delta_time()
+        nonlocal plot_t, num_markers
 
         if paused:
             return
 
+        plot_t = get_time()
+        resolve_transitions()
+
+        if replay and not dpg.is_item_active(f"{tag}_replay_position"):
+            dpg.set_value(f"{tag}_replay_position", replay.position)
+
         # Scroll the plot
         dpg.set_axis_limits(f"{tag}_x_axis", plot_t - time_range, plot_t)
 
         # Update series data with visible events
-        visible = [
-            (eid, t, row, txt)
-            for eid, t, row, txt in events
-            if t >= plot_t - time_range * 2
-        ]
-
-        if visible:
-            x_data = [t for _, t, _, _ in visible]
-            y_data = [r * 0.5 + 0.5 for _, _, r, _ in visible]
-            dpg.set_value(f"{tag}_series", [x_data, y_data])
+        times, event_ids = get_visible_events()
+        rows = label_rows[event_ids]
+
+        if len(times):
+            dpg.set_value(
+                f"{tag}_series", [times.tolist(), (rows * 0.5 + 0.5).tolist()]
+            )
         else:
             dpg.set_value(f"{tag}_series", [[0], [0]])
 
+        # The transformed positions may still belong to the previous frame's data
         transformed_x = app_data[1]
         transformed_y = app_data[2]
-
-        # Draw visible events
-        visible = [
-            (eid, t, row, txt)
-            for eid, t, row, txt in events
-            if t >= plot_t - time_range * 2
-        ]
-
-        for visible_idx, (eid, evt_time, _, evt_text) in enumerate(visible):
-            age = plot_t - evt_time
-
-            if age > time_range * 2:
-                if dpg.does_item_exist(f"{tag}_{eid}_rect"):
-                    dpg.delete_item(f"{tag}_{eid}_rect")
-                    dpg.delete_item(f"{tag}_{eid}_text")
-                continue
-
-            if visible_idx >= len(transformed_x):
-                break
-
-            x_pos = transformed_x[visible_idx]
-            y_pos = transformed_y[visible_idx]
-
-            # Calculate fade based on age
-            alpha = max(0, min(255, int(255 * (1 - age / (time_range * 2)))))
-
-            color = get_event_color(evt_text)
-            faded_color = (color[0], color[1], color[2], alpha)
-
-            # Draw event marker and text
-            # Draw rectangle
-            text_width, text_height = dpg.get_text_size(evt_text)
-
-            if dpg.does_item_exist(f"{tag}_{eid}_rect"):
+        num_visible = min(len(times), len(transformed_x), len(transformed_y))
+
+        # Calculate fade based on age
+        ages = plot_t - times[:num_visible]
+        alphas = np.clip(255 * (1 - ages / (time_range * 2)), 0, 255).astype(int)
+        text_height = 14
+
+        for idx in range(num_visible):
+            eid = event_ids[idx]
+            x_pos = transformed_x[idx]
+            y_pos = transformed_y[idx]
+            faded_color = (*label_colors[eid], int(alphas[idx]))
+            pmin = (x_pos, y_pos - text_height / 2 - 4)
+            pmax = (x_pos + label_widths[eid] + 20, y_pos + text_height / 2 + 4)
+
+            if idx < num_markers:
                 dpg.configure_item(
-                    f"{tag}_{eid}_rect",
-                    pmin=(x_pos, y_pos - text_height / 2 - 4),
-                    pmax=(x_pos + text_width + 20, y_pos + text_height / 2 + 4),
+                    f"{tag}_marker_{idx}_rect",
+                    pmin=pmin,
+                    pmax=pmax,
                     fill=faded_color,
+                    color=faded_color,
+                    show=True,
                 )
                 dpg.configure_item(
-                    f"{tag}_{eid}_text",
+                    f"{tag}_marker_{idx}_text",
                     pos=(x_pos + 4, y_pos - 7),
+                    text=label_texts[eid],
+                    show=True,
                 )
             else:
                 dpg.push_container_stack(sender)
                 dpg.draw_rectangle(
-                    (x_pos, y_pos - text_height / 2 - 4),
-                    (x_pos + text_width + 20, y_pos + text_height / 2 + 4),
+                    pmin,
+                    pmax,
                     fill=faded_color,
                     color=faded_color,
-                    tag=f"{tag}_{eid}_rect",
+                    tag=f"{tag}_marker_{idx}_rect",
                 )
                 text_color = (255, 255, 255, 255)
-                # text_color = (255, 255, 255, alpha)
                 dpg.draw_text(
                     (x_pos + 4, y_pos - 7),
-                    evt_text,
+                    label_texts[eid],
                     size=14,
                     color=text_color,
-                    tag=f"{tag}_{eid}_text",
+                    tag=f"{tag}_marker_{idx}_text",
                 )
                 dpg.pop_container_stack()
+                num_markers += 1
+
+        # Hide the markers we don't need this frame
+        for idx in range(num_visible, num_markers):
+            dpg.configure_item(f"{tag}_marker_{idx}_rect", show=False)
+            dpg.configure_item(f"{tag}_marker_{idx}_text", show=False)
 
     def close():
-        nonlocal running
+        nonlocal running, recorder
         running = False
 
+        if replay:
+            replay.stop()
+        if recorder:
+            recorder.close()
+            recorder = None
+
         if listener_thread:
             listener_thread.join(timeout=0.5)
         if sock:
@@ -226,7 +628,7 @@ def eventlistener_dialog(*, tag: str = 0) -> str:
 
         with dpg.plot(
             width=-1,
-            height=-57,
+            height=plot_height,
             no_mouse_pos=True,
             no_menus=True,
             no_box_select=True,
@@ -276,6 +678,40 @@ def eventlistener_dialog(*, tag: str = 0) -> str:
                 callback=update_port,
                 width=100,
             )
+            dpg.add_text("|")
+            dpg.add_button(label="Record", callback=toggle_recording)
+            dpg.add_button(label="Replay...", callback=start_replay)
+
+        with dpg.group(
+            horizontal=True, show=False, tag=f"{tag}_replay_controls"
+        ):
+            dpg.add_slider_float(
+                label="Position",
+                min_value=0.0,
+                max_value=1.0,
+                format="%.2fs",
+                callback=seek_replay,
+                width=-300,
+                tag=f"{tag}_replay_position",
+            )
+            dpg.add_slider_int(
+                label="Speed",
+                default_value=1,
+                min_value=1,
+                max_value=100,
+                format="%dx",
+                callback=set_replay_speed,
+                width=100,
+                tag=f"{tag}_replay_speed",
+            )
+            dpg.add_button(label="Live", callback=stop_replay)
+
+        if behavior:
+            dpg.add_text(
+                "No transitions triggered yet",
+                color=style.yellow,
+                tag=f"{tag}_transitions",
+            )
 
         instructions = """\
 https://ndahn.github.io/HkbEditor/howto/tools/event_listener/
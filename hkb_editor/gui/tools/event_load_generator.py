@@ -0,0 +1,190 @@
+#!/usr/bin/env python3
+"""Sends fake behavior events to the event listener at a fixed rate.
+
+Run with `--verify` to also receive the events in the background and report how many of them made it into an `EventRingBuffer`, as well as how long slicing the buffer takes per frame:
+
+    python -m hkb_editor.gui.tools.event_load_generator --rate 10000 --verify
+
+Adding `--capture <file>` will also record the received events and replay the capture at 100x speed afterwards.
+"""
+import argparse
+import socket
+import threading
+import time
+
+from hkb_editor.gui.tools.event_listener import EventRingBuffer, receive_events
+from hkb_editor.gui.tools.event_capture import (
+    EventCaptureWriter,
+    EventCapture,
+    CaptureReplay,
+)
+
+
+def generate_events(
+    port: int,
+    rate: int,
+    duration: float,
+    *,
+    num_characters: int = 50,
+    num_events: int = 200,
+) -> int:
+    """Send events over UDP in the same format as the game-side event listener.
+
+    Parameters
+    ----------
+    port : int
+        Port on localhost to send the events to.
+    rate : int
+        Events to send per second.
+    duration : float
+        How long to send events for in seconds.
+    num_characters : int, optional
+        Number of different characters the events appear to come from.
+    num_events : int, optional
+        Number of different event names.
+
+    Returns
+    -------
+    int
+        The number of events sent.
+    """
+    messages = [
+        f"c{1000 + c * 10:04d}:W_Event{e}".encode()
+        for c in range(num_characters)
+        for e in range(num_events)
+    ]
+    remote = ("localhost", port)
+    sent = 0
+
+    with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as sock:
+        start = time.perf_counter()
+        end = start + duration
+
+        while True:
+            now = time.perf_counter()
+            if now >= end:
+                break
+
+            # Catch up with the number of events that should have been sent by now
+            due = int((now - start) * rate)
+            while sent < due:
+                sock.sendto(messages[sent % len(messages)], remote)
+                sent += 1
+
+            time.sleep(0.0005)
+
+    return sent
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--port", type=int, default=27072)
+    parser.add_argument("--rate", type=int, default=10000, help="Events per second")
+    parser.add_argument("--duration", type=float, default=10.0, help="Seconds")
+    parser.add_argument(
+        "--verify",
+        action="store_true",
+        help="Receive the events in the background and report the throughput",
+    )
+    parser.add_argument(
+        "--capture",
+        help="Record the received events to this file and replay them (requires --verify)",
+    )
+    args = parser.parse_args()
+
+    if not args.verify:
+        sent = generate_events(args.port, args.rate, args.duration)
+        print(f"Sent {sent} events in {args.duration:.1f}s")
+        return
+
+    running = True
+    events = EventRingBuffer()
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 1 << 20)
+    sock.settimeout(0.1)
+    sock.bind(("localhost", args.port))
+
+    recorder = EventCaptureWriter(args.capture) if args.capture else None
+    listener = threading.Thread(
+        target=receive_events,
+        args=(sock, events, lambda: running),
+        kwargs={"on_event": recorder.write if recorder else None},
+        daemon=True,
+    )
+    listener.start()
+
+    # Emulate the render loop slicing the last 20 seconds at 60 fps
+    frame_times = []
+
+    def render():
+        while running:
+            t = time.perf_counter()
+            events.get_range(t - 20.0)
+            frame_times.append(time.perf_counter() - t)
+            time.sleep(1 / 60)
+
+    renderer = threading.Thread(target=render, daemon=True)
+    renderer.start()
+
+    start = time.perf_counter()
+    sent = generate_events(args.port, args.rate, args.duration)
+    elapsed = time.perf_counter() - start
+
+    # Let the listener drain the socket
+    time.sleep(0.5)
+    running = False
+    listener.join()
+    renderer.join()
+    sock.close()
+    if recorder:
+        recorder.close()
+
+    received = events.count
+    print(f"Sent {sent} events in {elapsed:.2f}s ({sent / elapsed:.0f}/s)")
+    print(
+        f"Received {received} events ({received / elapsed:.0f}/s), "
+        f"lost {sent - received} ({(sent - received) / max(sent, 1):.2%})"
+    )
+    if frame_times:
+        frame_times.sort()
+        print(
+            f"Slicing the buffer took {sum(frame_times) / len(frame_times) * 1000:.3f}ms "
+            f"on average, {frame_times[int(len(frame_times) * 0.99)] * 1000:.3f}ms p99"
+        )
+
+    if args.capture:
+        verify_capture(args.capture, received)
+
+
+def verify_capture(file_path: str, expected: int, speed: float = 100.0) -> None:
+    capture = EventCapture(file_path)
+    print(
+        f"Capture contains {len(capture)} of {expected} events, "
+        f"{len(capture.messages)} distinct messages over {capture.duration:.2f}s"
+    )
+
+    replayed = EventRingBuffer(max(len(capture), 1))
+    replay = CaptureReplay(capture, replayed, speed=speed)
+
+    start = time.perf_counter()
+    replay.start()
+    while not replay.finished:
+        time.sleep(0.01)
+    replay.stop()
+    elapsed = time.perf_counter() - start
+
+    _, event_ids = replayed.get_range(-float("inf"))
+    # The oldest events may have been skipped if the buffer is full
+    first = replayed.count - len(event_ids)
+    matching = replayed.count == len(capture) and all(
+        replayed.names[eid] == capture.get_message(first + idx)
+        for idx, eid in enumerate(event_ids)
+    )
+    print(
+        f"Replayed {replayed.count} events at {speed:.0f}x in {elapsed:.2f}s, "
+        f"messages {'match' if matching else 'DO NOT match'}"
+    )
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,136 @@
+from typing import Any, Iterable
+import pyperclip
+from dearpygui import dearpygui as dpg
+
+from hkb_editor.hkb.behavior import HavokBehavior
+from hkb_editor.hkb.memory_report import memory_report, MemoryReport
+from hkb_editor.gui.helpers import add_paragraphs
+from hkb_editor.gui import style
+
+
+def memory_report_dialog(
+    behavior: HavokBehavior,
+    *,
+    extra: dict[str, Iterable[Any]] = None,
+    top: int = 30,
+    title: str = "Memory Report",
+    tag: str = None,
+) -> str:
+    """Show where the memory of a loaded behavior goes. See [memory_report][] for details.
+
+    Parameters
+    ----------
+    behavior : HavokBehavior
+        The behavior to inspect.
+    extra : dict[str, Iterable[Any]], optional
+        Additional subsystems to measure, e.g. GUI state.
+    top : int, optional
+        Number of rows to show for types and objects.
+    title : str, optional
+        Title of the dialog.
+    tag : str, optional
+        Tag of the dialog window.
+
+    Returns
+    -------
+    str
+        Tag of the dialog window.
+    """
+    if tag in (None, 0, ""):
+        tag = f"memory_report_dialog_{dpg.generate_uuid()}"
+
+    report: MemoryReport = None
+
+    def mb(num_bytes: int) -> str:
+        return f"{num_bytes / (1 << 20):.2f} MB"
+
+    def add_table(label: str, columns: list[str], rows: list[tuple]) -> None:
+        with dpg.tree_node(label=label, default_open=True):
+            with dpg.table(
+                policy=dpg.mvTable_SizingStretchProp,
+                borders_innerH=True,
+                row_background=True,
+            ):
+                for col in columns:
+                    dpg.add_table_column(label=col)
+
+                for row in rows:
+                    with dpg.table_row():
+                        for val in row:
+                            dpg.add_text(val)
+
+    def refresh() -> None:
+        nonlocal report
+
+        dpg.delete_item(f"{tag}_content", children_only=True)
+        dpg.set_value(f"{tag}_status", "Measuring...")
+        dpg.split_frame()
+
+        report = memory_report(behavior, top=top, extra=extra)
+        report.notes.insert(
+            0, f"The GUI consists of {len(dpg.get_all_items())} dearpygui items."
+        )
+        accounted = sum(report.subsystems.values())
+        dpg.set_value(f"{tag}_status", f"Resident size: {mb(report.resident)}")
+
+        with dpg.group(parent=f"{tag}_content"):
+            subsystems = sorted(report.subsystems.items(), key=lambda x: -x[1])
+            add_table(
+                "By Subsystem",
+                ["Subsystem", "Size"],
+                [(name, mb(size)) for name, size in subsystems]
+                + [("(not accounted for)", mb(report.resident - accounted))],
+            )
+
+            by_type = sorted(report.by_type.items(), key=lambda x: -x[1])[:top]
+            add_table(
+                f"By Type (top {top})",
+                ["Type", "Size"],
+                [(type_name, mb(size)) for type_name, size in by_type],
+            )
+
+            add_table(
+                f"Largest Objects (top {top})",
+                ["ID", "Type", "Size"],
+                [
+                    (oid, type_name, mb(size))
+                    for oid, type_name, size in report.top_objects
+                ],
+            )
+
+            if report.traced is not None:
+                add_table(
+                    f"Traced Python Allocations (top {top})",
+                    ["File", "Size"],
+                    [(name, mb(size)) for name, size in report.traced[:top]],
+                )
+
+            for note in report.notes:
+                add_paragraphs(note, 80, color=style.light_blue)
+
+    def copy_report() -> None:
+        if report:
+            pyperclip.copy(report.format(top))
+
+    with dpg.window(
+        label=title,
+        width=600,
+        height=700,
+        no_saved_settings=True,
+        tag=tag,
+        on_close=lambda: dpg.delete_item(window),
+    ) as window:
+        dpg.add_text("", tag=f"{tag}_status")
+        dpg.add_separator()
+
+        with dpg.child_window(height=-30, border=False):
+            dpg.add_group(tag=f"{tag}_content")
+
+        dpg.add_separator()
+
+        with dpg.group(horizontal=True):
+            dpg.add_button(label="Refresh", callback=refresh)
+            dpg.add_button(label="Copy", callback=copy_report)
+
+    refresh()
+    return tag
@@ -1,12 +1,17 @@
 from typing import Any, Callable
 from dataclasses import dataclass
+from threading import Thread
+from queue import Queue, Empty
+import logging
 import networkx as nx
 from dearpygui import dearpygui as dpg
 
 from hkb_editor.hkb.behavior import HavokBehavior
 from hkb_editor.hkb.hkb_types import HkbRecord, HkbArray
 from hkb_editor.gui.widgets.graph_layout import HorizontalGraphLayout, Node
-from hkb_editor.gui.helpers import make_copy_menu
+from hkb_editor.gui.widgets.force_layout import barnes_hut_layout, remove_overlaps
+from hkb_editor.gui.helpers import make_copy_menu, estimate_drawn_text_size
+from hkb_editor.gui import style
 
 
 @dataclass
@@ -41,20 +46,48 @@ def open_state_graph_viewer(
 
     sm_type = behavior.type_registry.find_first_type_by_name("hkbStateMachine")
     statemachines = {sm.object_id: sm for sm in behavior.find_objects_by_type(sm_type)}
-    sm_items = sorted(sm["name"].get_value() for sm in statemachines.values())
+    statemachines_by_name = {
+        sm["name"].get_value(): sm for sm in statemachines.values()
+    }
+    sm_items = sorted(statemachines_by_name.keys())
+
+    # Transition events are named <source>_to_<target>. Index them once so that we
+    # only have to look up the states of the selected statemachine.
+    events_by_source: dict[str, list[tuple[str, str, int]]] = {}
+    events_by_target: dict[str, list[tuple[str, str, int]]] = {}
+    num_indexed_events = 0
+
+    def update_event_index() -> None:
+        nonlocal num_indexed_events
+
+        events = behavior.get_events()
+        if len(events) == num_indexed_events:
+            return
+
+        events_by_source.clear()
+        events_by_target.clear()
+
+        for idx, event in enumerate(events):
+            if "_to_" in event:
+                src, dst = event.split("_to_", maxsplit=1)
+                events_by_source.setdefault(src, []).append((dst, event, idx))
+                events_by_target.setdefault(dst, []).append((src, event, idx))
+
+        num_indexed_events = len(events)
+
+    # Layouts are calculated in the background and handed back to the UI thread through
+    # this queue (dearpygui is not thread safe). Results of outdated requests are dropped
+    layout_generation = 0
+    layout_results: Queue = Queue()
 
-    # TODO layout works fine, but node separation is bad with many nodes
     def refresh():
-        dpg.delete_item(f"{tag}_canvas_root", children_only=True)
+        nonlocal layout_generation
+        layout_generation += 1
+        generation = layout_generation
 
         statemachine_name = dpg.get_value(f"{tag}_statemachine")
         layout_name = dpg.get_value(f"{tag}_layout")
-
-        selected_sm = next(
-            sm
-            for sm in statemachines.values()
-            if sm["name"].get_value() == statemachine_name
-        )
+        selected_sm = statemachines_by_name[statemachine_name]
 
         state_pointers: HkbArray = selected_sm["states"]
         state_records = sorted(
@@ -64,29 +97,36 @@ def open_state_graph_viewer(
         states_by_id = {s["stateId"].get_value(): s for s in state_records}
         states_by_name = {s["name"].get_value(): s for s in states_by_id.values()}
 
-        # TODO useful?
-        transition_array_id = selected_sm["wildcardTransitions"].get_value()
-        if transition_array_id:
-            transitions_array: HkbRecord = behavior.objects[transition_array_id]
-            transitions: HkbArray = transitions_array["transitions"]
-
         g = nx.DiGraph()
+        sizes = {}
 
         for sname, state in states_by_name.items():
-            state_id = states_by_name[sname]["stateId"].get_value()
+            state_id = state["stateId"].get_value()
             g.add_node(sname, record=state, state_id=state_id)
+            sizes[sname] = estimate_drawn_text_size(
+                len(f"{sname} ({state_id})"),
+                font_size=12,
+                margin=graph_layout.text_margin,
+            )
 
-        for idx, event in enumerate(behavior.get_events()):
-            if "_to_" in event:
-                src, dst = event.split("_to_", maxsplit=1)
-                if src in states_by_name and dst in states_by_name:
-                    g.add_edge(src, dst, event=event, idx=idx)
+        update_event_index()
+        logger = logging.getLogger()
+
+        for sname in states_by_name.keys():
+            for dst, event, idx in events_by_source.get(sname, ()):
+                if dst in states_by_name:
+                    g.add_edge(sname, dst, event=event, idx=idx)
                 else:
-                    if src in states_by_name or dst in states_by_name:
-                        # Can this even happen? Should we add an "external" node?
-                        print(
-                            f"Event {event} has only one edge connected in the current SM"
-                        )
+                    # Can this even happen? Should we add an "external" node?
+                    logger.debug(
+                        f"Event {event} has only one edge connected in the current SM"
+                    )
+
+            for src, event, idx in events_by_target.get(sname, ()):
+                if src not in states_by_name:
+                    logger.debug(
+                        f"Event {event} has only one edge connected in the current SM"
+                    )
 
         # Adjust scaling and center to canvas size and origin
         # TODO once resizing the canvas with its container works we can do this properly
@@ -95,10 +135,49 @@ def open_state_graph_viewer(
         center = (300, 300)
         separation = dpg.get_value(f"{tag}_node_separation")
 
-        pos = layout_functions[layout_name](g)
-        pos = nx.spring_layout(g, 1, pos=pos, scale=separation, center=center)
-        graph_layout.cache = pos
+        def calculate_layout():
+            pos = None
+
+            try:
+                try:
+                    initial_pos = layout_functions[layout_name](g)
+                except nx.NetworkXException:
+                    # Not planar
+                    initial_pos = None
+
+                pos = barnes_hut_layout(
+                    g, initial_pos, scale=separation, center=center, seed=0
+                )
+                pos = remove_overlaps(pos, sizes)
+            except Exception as e:
+                logger.error(f"Failed to calculate layout: {e}", exc_info=e)
+            finally:
+                layout_results.put((generation, g, pos))
+
+        dpg.show_item(f"{tag}_layout_status")
+        Thread(target=calculate_layout, daemon=True).start()
+
+    def poll_layouts() -> None:
+        # Called every frame while the layout status is visible
+        while True:
+            try:
+                generation, g, pos = layout_results.get_nowait()
+            except Empty:
+                return
+
+            apply_layout(generation, g, pos)
 
+    def apply_layout(
+        generation: int, g: nx.DiGraph, pos: dict[str, tuple[float, float]]
+    ) -> None:
+        if generation != layout_generation:
+            return
+
+        dpg.hide_item(f"{tag}_layout_status")
+        if pos is None:
+            return
+
+        graph_layout.cache = pos
         canvas.set_graph(g)
         canvas.reveal_all_nodes()
         canvas.set_origin(0, 0)
@@ -137,14 +216,19 @@ def open_state_graph_viewer(
         dpg.show_item(popup)
 
     def on_close():
+        nonlocal layout_generation
+        # Discard layouts that are still being calculated
+        layout_generation += 1
+
         # Make sure the canvas can clean up its handlers and so on
         canvas.deinit()
         dpg.delete_item(window)
+        dpg.delete_item(layout_handlers)
 
     if statemachine_id:
         default_sm = statemachines[statemachine_id]["name"].get_value()
     else:
-        default_sm = next(sm for sm in statemachines.values())["name"].get_value()
+        default_sm = next(iter(statemachines_by_name))
 
     with dpg.window(
         label=title,
@@ -210,6 +294,17 @@ def open_state_graph_viewer(
                     label="Node separation",
                     tag=f"{tag}_node_separation",
                 )
+                dpg.add_text(
+                    "Calculating layout...",
+                    show=False,
+                    color=style.light_blue,
+                    tag=f"{tag}_layout_status",
+                )
+
+    with dpg.item_handler_registry() as layout_handlers:
+        dpg.add_item_visible_handler(callback=poll_layouts)
+
+    dpg.bind_item_handler_registry(f"{tag}_layout_status", layout_handlers)
 
     dpg.split_frame()
     refresh()
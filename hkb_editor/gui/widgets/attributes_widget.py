@@ -5,6 +5,7 @@ import yaml
 import logging
 import re
 from enum import IntFlag
+from contextlib import contextmanager
 from dataclasses import dataclass
 from dearpygui import dearpygui as dpg
 import pyperclip
@@ -28,7 +29,7 @@ from hkb_editor.hkb.index_attributes import (
     is_variable_attribute,
     is_animation_attribute,
 )
-from hkb_editor.hkb.xml import xml_from_str
+from hkb_editor.hkb.xml import xml_from_str, HkbXmlElement, MutationType
 from hkb_editor.templates.common import CommonActionsMixin
 
 from hkb_editor.gui.dialogs import (
@@ -41,8 +42,10 @@ from .table_tree import (
     table_tree_leaf,
     add_lazy_table_tree_node,
     get_row_node_item,
+    get_row_level,
+    is_foldable_row,
+    is_foldable_row_leaf,
     set_foldable_row_status,
-    is_foldable_row_expanded,
 )
 from .rotation_knob import RotationKnob
 from hkb_editor.gui.workflows.bind_attribute import (
@@ -104,6 +107,15 @@ class AttributesWidget:
         self._hide_title = hide_title
 
         self._attribute_info: dict[str, _Attribute] = {}
+        # Maps the xml elements of materialized attributes to their paths
+        self._element_paths: dict[HkbXmlElement, str] = {}
+        # Mutations caused by this widget are already reflected in its items
+        self._ignore_mutations = 0
+        # Paths of expanded records and arrays, used to restore them on regenerate
+        self._expanded_paths: set[str] = set()
+        # Index of the first materialized item of large arrays
+        self._array_windows: dict[str, int] = {}
+        self.array_window_size = 100
         self._selected_attribute_info: _Attribute = None
         self._attributes_table = None
 
@@ -118,14 +130,26 @@ class AttributesWidget:
         self._setup_content()
 
     def set_record(self, record: HkbRecord) -> None:
-        if record == self.record:
+        if (
+            record
+            and self.record
+            and record.element is self.record.element
+            and self._attribute_info
+            and self.tagfile.is_undo_enabled()
+        ):
+            # Changes are applied through mutation notifications as they happen
+            self.record = record
+        elif record and record == self.record:
             self.regenerate()
         else:
             self.clear()
-            self.tagfile = record.tagfile
-            self.record = record
+            self._expanded_paths.clear()
+            self._array_windows.clear()
 
             if record:
+                self.tagfile = record.tagfile
+                self.record = record
+                self.tagfile.add_mutation_listener(self._on_mutation)
                 self._rebuild_attributes()
 
     def set_title(self, title: str) -> None:
@@ -136,7 +160,18 @@ class AttributesWidget:
             dpg.show_item(f"{self.tag}_attributes_title")
 
     def clear(self) -> None:
+        self._clear_rows()
+
+        # Don't keep listening to (and referencing) a behavior we no longer show
+        if self.tagfile:
+            self.tagfile.remove_mutation_listener(self._on_mutation)
+
+        self.tagfile = None
+        self.record = None
+
+    def _clear_rows(self) -> None:
         self._attribute_info.clear()
+        self._element_paths.clear()
         self.set_title("Attributes")
         dpg.delete_item(self._attributes_table, children_only=True, slot=1)
 
@@ -158,8 +193,222 @@ class AttributesWidget:
 
             if len(subparts) > 1:
                 for idx in subparts[1:]:
+                    self._show_array_item(subpath, int(idx))
                     reveal(f":{idx}")
 
+    def _show_array_item(self, path: str, idx: int) -> None:
+        # Move the array's window so that it includes the item
+        start = self._array_windows.get(path, 0)
+        if start <= idx < start + self.array_window_size:
+            return
+
+        self._set_array_window(path, idx - idx % self.array_window_size)
+
+    def _set_array_window(self, path: str, start: int) -> None:
+        self._array_windows[path] = max(0, start)
+
+        # Rebuild the item rows if the array is currently expanded
+        row = f"{self.tag}_attribute_{path}"
+        if path in self._expanded_paths:
+            set_foldable_row_status(row, False)
+            set_foldable_row_status(row, True)
+
+    def _on_attribute_expanded(self, path: str) -> None:
+        self._expanded_paths.add(path)
+
+    def _on_attribute_folded(self, path: str) -> None:
+        # The rows of nested attributes are deleted when folding
+        self._expanded_paths.difference_update(
+            p
+            for p in list(self._expanded_paths)
+            if p == path or p.startswith(path + "/") or p.startswith(path + ":")
+        )
+
+    @contextmanager
+    def _ignore_own_mutations(self):
+        self._ignore_mutations += 1
+        try:
+            yield
+        finally:
+            self._ignore_mutations -= 1
+
+    def _on_mutation(
+        self, mutation: MutationType, elements: tuple[HkbXmlElement, ...]
+    ) -> None:
+        if self._ignore_mutations or not self.record:
+            return
+
+        record_element = self.record.element
+        # Materialized attributes containing the changed elements, and whether the
+        # attribute's own element was changed
+        affected: dict[str, bool] = {}
+
+        for elem in elements:
+            node = elem
+            while node is not None:
+                path = self._element_paths.get(node)
+                if path is not None:
+                    attr = self._attribute_info.get(path)
+                    if attr and attr.attribute.element is node:
+                        affected[path] = affected.get(path, False) or node is elem
+                    break
+
+                if node is record_element:
+                    if mutation == MutationType.STRUCTURE:
+                        # The record's fields have changed
+                        self.regenerate()
+                        return
+                    break
+
+                node = node.getparent()
+
+        refreshed = []
+        # Parents first, refreshing them will recreate their children
+        for path in sorted(affected, key=len):
+            if any(path.startswith((p + "/", p + ":")) for p in refreshed):
+                continue
+
+            attr = self._attribute_info[path]
+            if not dpg.does_item_exist(attr.widget):
+                continue
+
+            if is_foldable_row(attr.widget) and not is_foldable_row_leaf(attr.widget):
+                # Changes inside folded records and arrays are not visible
+                if mutation == MutationType.STRUCTURE:
+                    self._refresh_foldable_attribute(attr)
+                    refreshed.append(path)
+                elif affected[path]:
+                    self._refresh_foldable_attribute(attr, reexpand=False)
+            else:
+                self._recreate_attribute_row(attr)
+                refreshed.append(path)
+
+    def _refresh_foldable_attribute(
+        self, attr: _Attribute, reexpand: bool = True
+    ) -> None:
+        path = attr.path
+        label, _ = self._get_attribute_label(attr.attribute, path)
+        if isinstance(attr.attribute, HkbArray):
+            label = f"{label} ({len(attr.attribute)})"
+
+        dpg.configure_item(get_row_node_item(attr.widget), label=label)
+
+        if not reexpand or path not in self._expanded_paths:
+            return
+
+        if isinstance(attr.attribute, HkbArray) and self._update_array_rows(attr):
+            return
+
+        nested = sorted(
+            (
+                p
+                for p in self._expanded_paths
+                if p.startswith(path + "/") or p.startswith(path + ":")
+            ),
+            key=len,
+        )
+        set_foldable_row_status(attr.widget, False)
+        set_foldable_row_status(attr.widget, True)
+
+        for p in nested:
+            self.reveal_attribute(p)
+
+    def _update_array_rows(self, attr: _Attribute) -> bool:
+        # Items were only added or removed at the end of the array's window, so the
+        # remaining rows can be kept. Returns False if the rows need to be rebuilt.
+        array: HkbArray = attr.attribute
+        path = attr.path
+        tag = attr.widget
+        num_items = len(array)
+        start = self._array_windows.get(path, 0)
+        end = min(start + self.array_window_size, num_items)
+
+        if start > 0 and start >= num_items:
+            return False
+
+        old_end = start
+        while dpg.does_item_exist(f"{tag}:{old_end}"):
+            old_end += 1
+
+        for idx in range(start, min(old_end, end)):
+            item = self._attribute_info.get(f"{path}:{idx}")
+            if not item or item.attribute.element is not array[idx].element:
+                return False
+
+        removed = [f"{path}:{idx}" for idx in range(end, old_end)]
+        if any(p in self._expanded_paths for p in removed):
+            return False
+
+        for item_path in removed:
+            item = self._attribute_info.pop(item_path)
+            dpg.delete_item(self._get_attribute_row(item))
+
+        window_row = f"{tag}_arraywindow"
+        if dpg.does_item_exist(window_row):
+            dpg.delete_item(window_row)
+
+        with self._table_level(get_row_level(tag) + 1):
+            for idx in range(old_end, end):
+                self._create_attribute_widget(
+                    array[idx], f"{path}:{idx}", before=f"{tag}_arraybuttons"
+                )
+                item = self._attribute_info[f"{path}:{idx}"]
+                dpg.show_item(self._get_attribute_row(item))
+
+            if num_items > self.array_window_size:
+                first_item = self._attribute_info.get(f"{path}:{start}")
+                if first_item and dpg.does_item_exist(first_item.widget):
+                    before = self._get_attribute_row(first_item)
+                else:
+                    before = f"{tag}_arraybuttons"
+
+                with table_tree_leaf(
+                    table=self._attributes_table,
+                    tag=window_row,
+                    before=before,
+                ):
+                    self._create_attribute_widget_array_window(
+                        path, start, end, num_items
+                    )
+                dpg.show_item(window_row)
+
+        return True
+
+    def _get_attribute_row(self, attr: _Attribute) -> int:
+        row = attr.widget
+        if isinstance(row, str):
+            row = dpg.get_alias_id(row)
+
+        while dpg.get_item_type(row) != "mvAppItemType::mvTableRow":
+            row = dpg.get_item_parent(row)
+
+        return row
+
+    @contextmanager
+    def _table_level(self, level: int):
+        # New rows are created on the table's current indent level
+        table_level = dpg.get_item_user_data(self._attributes_table)
+        dpg.set_item_user_data(self._attributes_table, level)
+        try:
+            yield
+        finally:
+            dpg.set_item_user_data(self._attributes_table, table_level)
+
+    def _recreate_attribute_row(self, attr: _Attribute) -> None:
+        row = self._get_attribute_row(attr)
+        rows = dpg.get_item_children(self._attributes_table, slot=1)
+        row_idx = rows.index(row)
+        before = rows[row_idx + 1] if row_idx + 1 < len(rows) else 0
+        level = get_row_level(row)
+
+        dpg.delete_item(row)
+        with self._table_level(level):
+            self._create_attribute_widget(attr.attribute, attr.path, before=before)
+
+        # The row replaces a visible one
+        row = dpg.get_item_children(self._attributes_table, slot=1)[row_idx]
+        dpg.show_item(row)
+
     def get_explanation(self, path: str) -> str:
         path = re.sub(r":[0-9]+", "", path)
 
@@ -224,7 +473,7 @@ class AttributesWidget:
         self._create_attribute_menu()
 
     def _rebuild_attributes(self) -> None:
-        self.clear()
+        self._clear_rows()
         self.set_title(f"{self.record.object_id} ({self.record.type_name})")
 
         # Columns will be hidden if header_row=False and no rows exist initially
@@ -239,30 +488,14 @@ class AttributesWidget:
                 self._create_attribute_widget(val, key)
 
     def regenerate(self):
-        revealed = []
-
-        for path, _ in self.record.find_fields_by_class(HkbRecord):
-            attr = self._attribute_info.get(path)
-            if (
-                attr
-                and dpg.does_item_exist(attr.widget)
-                and is_foldable_row_expanded(attr.widget)
-            ):
-                revealed.append(path)
-
-        for path, _ in self.record.find_fields_by_class(HkbArray):
-            attr = self._attribute_info.get(path)
-            if (
-                attr
-                and dpg.does_item_exist(attr.widget)
-                and is_foldable_row_expanded(attr.widget)
-            ):
-                revealed.append(path)
-
-        self._rebuild_attributes()
+        if not self.record:
+            return
 
         # Need to reveal the parent attributes before children can be revealed
-        revealed.sort(key=len)
+        revealed = sorted(self._expanded_paths, key=len)
+        self._expanded_paths.clear()
+
+        self._rebuild_attributes()
 
         for path in revealed:
             self.reveal_attribute(path)
@@ -324,6 +557,7 @@ class AttributesWidget:
         if isinstance(attribute, HkbRecord):
             # create items on demand, dpg performance tanks with too many widgets
             def lazy_create_record_attributes(anchor: str):
+                self._on_attribute_expanded(path)
                 for subkey, subval in attribute.get_value().items():
                     self._create_attribute_widget(
                         subval, f"{path}/{subkey}", before=anchor
@@ -335,6 +569,7 @@ class AttributesWidget:
                 table=self._attributes_table,
                 tag=tag,
                 before=before,
+                fold_callback=lambda: self._on_attribute_folded(path),
             )
             widget = get_row_node_item(tag)
 
@@ -365,9 +600,30 @@ class AttributesWidget:
             else:
                 # create items on demand, dpg performance tanks with too many widgets
                 def lazy_create_array_items(anchor: str):
-                    for idx, subval in enumerate(attribute):
+                    self._on_attribute_expanded(path)
+
+                    # Only materialize a window of items, large arrays would create
+                    # thousands of widgets otherwise
+                    num_items = len(attribute)
+                    start = self._array_windows.get(path, 0)
+                    if start >= num_items:
+                        start = max(0, num_items - num_items % self.array_window_size)
+                        self._array_windows[path] = start
+                    end = min(start + self.array_window_size, num_items)
+
+                    if num_items > self.array_window_size:
+                        with table_tree_leaf(
+                            table=self._attributes_table,
+                            tag=f"{tag}_arraywindow",
+                            before=anchor,
+                        ):
+                            self._create_attribute_widget_array_window(
+                                path, start, end, num_items
+                            )
+
+                    for idx in range(start, end):
                         self._create_attribute_widget(
-                            subval, f"{path}:{idx}", before=anchor
+                            attribute[idx], f"{path}:{idx}", before=anchor
                         )
 
                     with table_tree_leaf(
@@ -383,6 +639,7 @@ class AttributesWidget:
                     table=self._attributes_table,
                     tag=tag,
                     before=before,
+                    fold_callback=lambda: self._on_attribute_folded(path),
                 )
                 widget = get_row_node_item(tag)
 
@@ -421,6 +678,7 @@ class AttributesWidget:
                     create_label()
 
         self._attribute_info[path] = _Attribute(attribute, path, tag, is_simple)
+        self._element_paths[attribute.element] = path
         dpg.set_item_user_data(widget, path)
         dpg.bind_item_handler_registry(widget, self.tag + "_item_handler_registry")
 
@@ -535,8 +793,9 @@ class AttributesWidget:
             default_open=False,
         ) as tree_node:
             # In some cases the array could still be empty
-            for i in range(0, 4 - len(array)):
-                array.append(0.0)
+            with self._ignore_own_mutations():
+                for i in range(0, 4 - len(array)):
+                    array.append(0.0)
 
             for i, comp in zip(range(4), "xyzw"):
                 value = array[i].get_value()
@@ -567,9 +826,10 @@ class AttributesWidget:
             rpy = [knob.radians for knob in knobs]
             quat = euler_to_quat(*rpy)
 
-            for idx, comp in enumerate("xyzw"):
-                val = quat[idx]
-                array[idx].set_value(val)
+            with self._ignore_own_mutations():
+                for idx, comp in enumerate("xyzw"):
+                    val = quat[idx]
+                    array[idx].set_value(val)
 
         def refresh_quaternion(*args) -> None:
             q = []
@@ -588,11 +848,12 @@ class AttributesWidget:
             tag=f"{self.tag}_{path}_quaternion",
         ) as tree_node:
             # In some cases the array could still be empty
-            for idx in range(0, 4 - len(array)):
-                if idx == 3:
-                    array.append(1.0)
-                else:
-                    array.append(0.0)
+            with self._ignore_own_mutations():
+                for idx in range(0, 4 - len(array)):
+                    if idx == 3:
+                        array.append(1.0)
+                    else:
+                        array.append(0.0)
 
             with dpg.group(horizontal=True) as knob_group:
                 values = [array[i].get_value() for i in range(4)]
@@ -626,6 +887,32 @@ class AttributesWidget:
 
         return tree_node
 
+    def _create_attribute_widget_array_window(
+        self,
+        path: str,
+        start: int,
+        end: int,
+        num_items: int,
+    ) -> str:
+        step = self.array_window_size
+
+        with dpg.group(horizontal=True) as window_group:
+            dpg.add_button(
+                arrow=True,
+                direction=dpg.mvDir_Left,
+                enabled=start > 0,
+                callback=lambda: self._set_array_window(path, start - step),
+            )
+            dpg.add_text(f"{start} - {end - 1} of {num_items}")
+            dpg.add_button(
+                arrow=True,
+                direction=dpg.mvDir_Right,
+                enabled=end < num_items,
+                callback=lambda: self._set_array_window(path, start + step),
+            )
+
+        return window_group
+
     def _create_attribute_widget_array_buttons(
         self,
         array: HkbArray,
@@ -650,9 +937,11 @@ class AttributesWidget:
                 if self._on_graph_changed:
                     self._on_graph_changed()
 
-            item_path = f"{path}:{len(array) - 1}"
-            attr = self._attribute_info[item_path]
-            dpg.delete_item(attr.widget)
+            # The item may not be materialized if it is outside the array's window
+            item_path = f"{path}:{idx}"
+            attr = self._attribute_info.pop(item_path, None)
+            if attr and dpg.does_item_exist(attr.widget):
+                dpg.delete_item(attr.widget)
 
         def append_item() -> None:
             subtype = array.element_type_id
@@ -666,17 +955,8 @@ class AttributesWidget:
                 path,
             )
 
+            # The array's rows are refreshed by the mutation notification
             array.append(new_item)
-
-            # TODO doesn't work for some reason
-            # self._create_attribute_widget(
-            #     self.record,
-            #     new_item,
-            #     f"{path}:{idx}",
-            #     before=tag,  # insert before the buttons
-            # )
-
-            self.regenerate()
             self.reveal_attribute(f"{path}:{len(array) - 1}")
 
         with dpg.group(horizontal=True, tag=tag) as button_group:
@@ -1130,7 +1410,8 @@ class AttributesWidget:
         ui_repr: Any = None,
     ) -> None:
         old_value = handler.get_value()
-        handler.set_value(new_value)
+        with self._ignore_own_mutations():
+            handler.set_value(new_value)
 
         if ui_repr is None:
             ui_repr = handler.get_value()
@@ -1451,7 +1732,6 @@ class AttributesWidget:
             if self._on_graph_changed:
                 self._on_graph_changed()
 
-            self.clear()
             self._rebuild_attributes()
             self.reveal_attribute(self._selected_attribute_info.path)
 
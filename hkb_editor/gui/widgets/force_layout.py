@@ -0,0 +1,316 @@
+from typing import Hashable
+import numpy as np
+import networkx as nx
+
+
+class _QuadTree:
+    """Flat quadtree over a set of points for Barnes-Hut approximations. Each cell stores its center of mass, the number of points it contains and its size.
+
+    Parameters
+    ----------
+    pos : np.ndarray
+        Array of shape (n, 2) of the points to insert.
+    max_depth : int, optional
+        Cells are not split any further beyond this depth, e.g. when several points share the same position.
+    """
+
+    def __init__(self, pos: np.ndarray, max_depth: int = 24):
+        n = len(pos)
+        lo = pos.min(axis=0)
+        extent = max(float((pos.max(axis=0) - lo).max()), 1e-9)
+        # Normalized to [0, 1)
+        unit = np.clip((pos - lo) / extent, 0.0, 1.0 - 1e-9)
+
+        com = []
+        mass = []
+        size = []
+        parents = []
+        quadrants = []
+
+        # The tree is built one level at a time. Points stay active until they are
+        # the only point in their cell.
+        active = np.arange(n)
+        point_cells = np.zeros(n, dtype=np.int64)
+        num_cells = 0
+
+        for depth in range(max_depth + 1):
+            if len(active) == 0:
+                break
+
+            cell_xy = np.floor(unit[active] * (1 << depth)).astype(np.int64)
+            keys = (cell_xy[:, 0] << 32) | cell_xy[:, 1]
+            unique_keys, inverse, counts = np.unique(
+                keys, return_inverse=True, return_counts=True
+            )
+            inverse = inverse.reshape(-1)
+            first = np.zeros(len(unique_keys), dtype=np.int64)
+            first[inverse[::-1]] = np.arange(len(inverse))[::-1]
+
+            com.append(
+                np.column_stack(
+                    (
+                        np.bincount(inverse, weights=pos[active, 0]) / counts,
+                        np.bincount(inverse, weights=pos[active, 1]) / counts,
+                    )
+                )
+            )
+            mass.append(counts)
+            size.append(np.full(len(unique_keys), extent / (1 << depth)))
+
+            if depth == 0:
+                parents.append(np.full(len(unique_keys), -1, dtype=np.int64))
+                quadrants.append(np.zeros(len(unique_keys), dtype=np.int64))
+            else:
+                parents.append(point_cells[active[first]])
+                quad_xy = cell_xy[first] & 1
+                quadrants.append(quad_xy[:, 0] + quad_xy[:, 1] * 2)
+
+            point_cells[active] = num_cells + inverse
+            num_cells += len(unique_keys)
+            active = active[counts[inverse] > 1]
+
+        self.com = np.concatenate(com)
+        self.mass = np.concatenate(mass).astype(np.float64)
+        self.size = np.concatenate(size)
+        self.children = np.full((num_cells, 4), -1, dtype=np.int64)
+
+        parents = np.concatenate(parents)
+        quadrants = np.concatenate(quadrants)
+        has_parent = parents >= 0
+        self.children[parents[has_parent], quadrants[has_parent]] = np.flatnonzero(
+            has_parent
+        )
+        self.is_leaf = (self.children < 0).all(axis=1)
+
+    def get_repulsion(self, pos: np.ndarray, k: float, theta: float) -> np.ndarray:
+        """Calculate the Fruchterman-Reingold repulsion every point experiences from all other points. Cells that appear small enough from a point are treated as a single body.
+
+        Parameters
+        ----------
+        pos : np.ndarray
+            The points the tree was built from.
+        k : float
+            Optimal distance between points.
+        theta : float
+            Ratio of cell size to distance below which cells are approximated.
+
+        Returns
+        -------
+        np.ndarray
+            Array of shape (n, 2) with the repulsive force acting on each point.
+        """
+        n = len(pos)
+        force_x = np.zeros(n)
+        force_y = np.zeros(n)
+
+        # Pairs of points and cells that still have to be evaluated
+        bodies = np.arange(n)
+        cells = np.zeros(n, dtype=np.int64)
+
+        while len(bodies):
+            delta = pos[bodies] - self.com[cells]
+            dist_sq = (delta**2).sum(axis=1)
+            dist = np.sqrt(dist_sq)
+
+            far = self.is_leaf[cells] | (self.size[cells] < theta * dist)
+            # Points don't repel themselves (or points in the exact same spot)
+            apply = far & (dist_sq > 1e-18)
+
+            weight = k * k * self.mass[cells[apply]] / dist_sq[apply]
+            force_x += np.bincount(
+                bodies[apply], weights=delta[apply, 0] * weight, minlength=n
+            )
+            force_y += np.bincount(
+                bodies[apply], weights=delta[apply, 1] * weight, minlength=n
+            )
+
+            # Open up all cells that are too close
+            near = ~far
+            sub = self.children[cells[near]]
+            valid = sub >= 0
+            bodies = np.repeat(bodies[near], valid.sum(axis=1))
+            cells = sub[valid]
+
+        return np.column_stack((force_x, force_y))
+
+
+def barnes_hut_layout(
+    graph: nx.Graph,
+    pos: dict[Hashable, tuple[float, float]] = None,
+    *,
+    iterations: int = 100,
+    theta: float = 0.9,
+    scale: float = 1.0,
+    center: tuple[float, float] = (0.0, 0.0),
+    seed: int = None,
+) -> dict[Hashable, np.ndarray]:
+    """Force-directed Fruchterman-Reingold layout where repulsion is approximated with a quadtree (Barnes-Hut), so each iteration is O(n log n) instead of O(n²).
+
+    Parameters
+    ----------
+    graph : nx.Graph
+        The graph to arrange. Edge directions are ignored.
+    pos : dict[Hashable, tuple[float, float]], optional
+        Initial positions. Nodes without a position are placed randomly.
+    iterations : int, optional
+        Number of simulation steps.
+    theta : float, optional
+        Barnes-Hut accuracy parameter, smaller is more accurate but slower.
+    scale : float, optional
+        The layout is rescaled so that the farthest node is this far from the center.
+    center : tuple[float, float], optional
+        Center of the final layout.
+    seed : int, optional
+        Seed for the random initial positions.
+
+    Returns
+    -------
+    dict[Hashable, np.ndarray]
+        Position of each node.
+    """
+    nodes = list(graph.nodes)
+    n = len(nodes)
+    if n == 0:
+        return {}
+
+    center = np.asarray(center, dtype=np.float64)
+    if n == 1:
+        return {nodes[0]: center}
+
+    rng = np.random.default_rng(seed)
+    points = rng.random((n, 2))
+
+    if pos:
+        known = [i for i, node in enumerate(nodes) if node in pos]
+        if known:
+            initial = np.array([pos[nodes[i]] for i in known], dtype=np.float64)
+            extent = (initial.max(axis=0) - initial.min(axis=0)).max()
+            if extent > 0:
+                points[known] = (initial - initial.min(axis=0)) / extent
+
+    node_indices = {node: i for i, node in enumerate(nodes)}
+    edges = np.array(
+        [(node_indices[a], node_indices[b]) for a, b in graph.edges if a != b],
+        dtype=np.int64,
+    ).reshape(-1, 2)
+
+    k = np.sqrt(1.0 / n)
+    temperature = 0.1
+    cooling = temperature / (iterations + 1)
+
+    for _ in range(iterations):
+        tree = _QuadTree(points)
+        displacement = tree.get_repulsion(points, k, theta)
+
+        if len(edges):
+            delta = points[edges[:, 0]] - points[edges[:, 1]]
+            dist = np.sqrt((delta**2).sum(axis=1))
+            pull = delta * (dist / k)[:, None]
+            np.subtract.at(displacement, edges[:, 0], pull)
+            np.add.at(displacement, edges[:, 1], pull)
+
+        length = np.sqrt((displacement**2).sum(axis=1))
+        length[length < 1e-9] = 1e-9
+        step = np.minimum(length, temperature) / length
+        points += displacement * step[:, None]
+        temperature -= cooling
+
+    points -= points.mean(axis=0)
+    max_dist = np.abs(points).max()
+    if max_dist > 0:
+        points *= scale / max_dist
+    points += center
+
+    return dict(zip(nodes, points))
+
+
+def remove_overlaps(
+    pos: dict[Hashable, tuple[float, float]],
+    sizes: dict[Hashable, tuple[float, float]],
+    *,
+    padding: float = 10.0,
+    expansion: float = 1.02,
+    max_iterations: int = 200,
+) -> dict[Hashable, tuple[float, float]]:
+    """Push apart overlapping rectangles along the axis of least overlap until none of them overlap anymore.
+
+    Parameters
+    ----------
+    pos : dict[Hashable, tuple[float, float]]
+        Top left corner of each rectangle.
+    sizes : dict[Hashable, tuple[float, float]]
+        Width and height of each rectangle.
+    padding : float, optional
+        Minimum space to keep between rectangles.
+    expansion : float, optional
+        Factor by which the layout is spread out in every pass that still finds overlaps.
+    max_iterations : int, optional
+        Give up after this many passes.
+
+    Returns
+    -------
+    dict[Hashable, tuple[float, float]]
+        The adjusted positions.
+    """
+    nodes = list(pos.keys())
+    if len(nodes) < 2:
+        return dict(pos)
+
+    points = np.array([pos[n] for n in nodes], dtype=np.float64)
+    extents = np.array([sizes[n] for n in nodes], dtype=np.float64) + padding
+    n = len(nodes)
+
+    # If the rectangles cannot fit in the covered area, spread them out first. Pushing
+    # them apart one pair at a time converges very slowly in crowded layouts.
+    centroid = (points + extents / 2).mean(axis=0)
+    covered = np.prod(points.max(axis=0) - points.min(axis=0) + extents.mean(axis=0))
+    required = np.prod(extents, axis=1).sum() * 2
+    if covered > 0 and required > covered:
+        points = centroid + (points - centroid) * np.sqrt(required / covered)
+
+    max_width = extents[:, 0].max()
+    offsets = np.arange(n)
+
+    for _ in range(max_iterations):
+        centers = points + extents / 2
+
+        # Sweep along x: only rectangles whose centers are closer than the widest
+        # rectangle can overlap
+        order = np.argsort(centers[:, 0], kind="stable")
+        sorted_x = centers[order, 0]
+        end = np.searchsorted(sorted_x, sorted_x + max_width, side="left")
+        counts = np.maximum(end - offsets - 1, 0)
+        first = np.repeat(offsets, counts)
+        second = first + 1 + np.arange(counts.sum()) - np.repeat(
+            np.cumsum(counts) - counts, counts
+        )
+        i = order[first]
+        j = order[second]
+
+        delta = centers[j] - centers[i]
+        overlap = (extents[i] + extents[j]) / 2 - np.abs(delta)
+        hit = (overlap[:, 0] > 0) & (overlap[:, 1] > 0)
+        if not hit.any():
+            break
+
+        i = i[hit]
+        j = j[hit]
+        ox, oy = overlap[hit].T
+        dx, dy = delta[hit].T
+
+        # Move both rectangles half the way along the axis of least overlap
+        along_x = ox < oy
+        amount = np.where(along_x, ox, oy) / 2
+        sign = np.where(np.where(along_x, dx, dy) >= 0, 1.0, -1.0)
+        push = np.zeros((len(i), 2))
+        push[along_x, 0] = (sign * amount)[along_x]
+        push[~along_x, 1] = (sign * amount)[~along_x]
+
+        moves = np.zeros_like(points)
+        np.subtract.at(moves, i, push)
+        np.add.at(moves, j, push)
+
+        # Expanding the whole layout a little helps with resolving dense clusters
+        points = centroid + (points + moves - centroid) * expansion
+
+    return {n: tuple(p) for n, p in zip(nodes, points)}
@@ -63,9 +63,54 @@ class GraphLayout:
     ) -> tuple[float, float]:
         return None
 
+    def reset(self) -> None:
+        """Called when all nodes have been removed from the canvas."""
+        pass
+
+    def on_node_placed(self, node: Node) -> None:
+        """Called after a node has been positioned and became visible."""
+        pass
+
+    def on_node_removed(self, node: Node) -> None:
+        """Called after a node has been hidden or removed from the canvas."""
+        pass
+
+
+class _LevelExtents:
+    # Right and bottom edges of the visible nodes on one level. The maxima are only
+    # recalculated when the node defining them is removed.
+    def __init__(self):
+        self.edges: dict[str, tuple[float, float]] = {}
+        self._right = 0.0
+        self._bottom = 0.0
+        self._dirty = False
+
+    def add(self, node_id: str, right: float, bottom: float) -> None:
+        self.edges[node_id] = (right, bottom)
+        if not self._dirty:
+            self._right = max(self._right, right)
+            self._bottom = max(self._bottom, bottom)
+
+    def remove(self, node_id: str) -> None:
+        right, bottom = self.edges.pop(node_id)
+        if right >= self._right or bottom >= self._bottom:
+            self._dirty = True
+
+    def get_extents(self) -> tuple[float, float]:
+        if self._dirty:
+            self._right = max((r for r, _ in self.edges.values()), default=0.0)
+            self._bottom = max((b for _, b in self.edges.values()), default=0.0)
+            self._dirty = False
+
+        return (max(0.0, self._right), max(0.0, self._bottom))
+
 
 @dataclass
 class HorizontalGraphLayout(GraphLayout):
+    def __post_init__(self):
+        self._levels: dict[int, _LevelExtents] = {}
+        self._node_levels: dict[str, int] = {}
+
     def get_pos_for_node(
         self, graph: nx.DiGraph, node: Node, nodemap: dict[str, Node]
     ) -> tuple[float, float]:
@@ -84,19 +129,9 @@ class HorizontalGraphLayout(GraphLayout):
         if level == 0:
             px, py = self.node0_margin
         else:
-            px = py = 0.0
-
-            for n in nodemap.values():
-                if n.visible:
-                    nl = n.level
-
-                    if nl == level:
-                        # Move down
-                        py = max(py, n.y + n.height)
-
-                    elif nl == (level - 1):
-                        # Move to the right
-                        px = max(px, n.x + n.width)
+            # Move to the right of the previous level and below the current one
+            px = self._get_level_extents(level - 1)[0]
+            py = self._get_level_extents(level)[1]
 
             px += self.gap_x * self.zoom_factor
 
@@ -106,3 +141,26 @@ class HorizontalGraphLayout(GraphLayout):
             py = max(ymin, py)
 
         return px, py
+
+    def reset(self) -> None:
+        self._levels.clear()
+        self._node_levels.clear()
+
+    def on_node_placed(self, node: Node) -> None:
+        self.on_node_removed(node)
+
+        x0, y0, x1, y1 = node.bbox
+        self._levels.setdefault(node.level, _LevelExtents()).add(node.id, x1, y1)
+        self._node_levels[node.id] = node.level
+
+    def on_node_removed(self, node: Node) -> None:
+        level = self._node_levels.pop(node.id, None)
+        if level is not None:
+            self._levels[level].remove(node.id)
+
+    def _get_level_extents(self, level: int) -> tuple[float, float]:
+        extents = self._levels.get(level)
+        if not extents:
+            return (0.0, 0.0)
+
+        return extents.get_extents()
@@ -7,6 +7,7 @@ from hkb_editor.external import get_config
 from hkb_editor.gui import style
 from hkb_editor.gui.helpers import estimate_drawn_text_size
 from .graph_layout import GraphLayout, HorizontalGraphLayout, Node
+from .spatial_grid import SpatialGrid, bbox_overlap
 
 
 class GraphWidget:
@@ -59,6 +60,20 @@ class GraphWidget:
         self.graph = None
         self.root: str = None
         self.nodes: dict[str, Node] = {}
+        # Bounding boxes of visible nodes for hit-testing and culling. Edges are culled
+        # per parent, as their connecting lines can be very long but are shared.
+        self.node_grid = SpatialGrid()
+        self.edge_grid = SpatialGrid((200.0, 4000.0))
+        self.edges: dict[str, set[str]] = {}
+        # Draw items are only created for nodes and edges close to the viewport
+        self.viewport_margin = 200.0
+        self._view_origin: tuple[float, float] = (0.0, 0.0)
+        self._drawn_nodes: set[str] = set()
+        self._drawn_edges: set[tuple[str, str]] = set()
+        self._node_colors: dict[str, tuple] = {}
+        self._hovered_nodes: set[str] = set()
+        # Frontpage lines, colors and unscaled size per node
+        self._frontpages: dict[str, tuple[list[str], list[tuple], tuple[float, float]]] = {}
         self.hovered_node: Node = None
         self.selected_node: Node = None
         self.transform: tuple[float, float] = (0.0, 0.0)
@@ -108,6 +123,7 @@ class GraphWidget:
 
     def set_graph(self, graph: nx.DiGraph) -> None:
         self.clear()
+        self._frontpages.clear()
         self.graph = graph
 
         if graph:
@@ -126,12 +142,10 @@ class GraphWidget:
             self._draw_node(self.nodes[self.root])
 
     def get_node_at_pos(self, x: float, y: float) -> Node:
-        for node in self.nodes.values():
-            # Something like a b-tree might have better performance,
-            # but so far this is not a bottleneck
-            if node.visible:
-                if node.contains(x, y):
-                    return node
+        for node_id in self.node_grid.query(x, y):
+            node = self.nodes.get(node_id)
+            if node and node.visible and node.contains(x, y):
+                return node
 
         return None
 
@@ -140,17 +154,22 @@ class GraphWidget:
         self.look_at(*self.transform)
 
     def look_at(self, px: float, py: float) -> None:
+        # Content is drawn in graph space, zoom and pan are applied on top
+        scale = self.zoom_factor
         dpg.apply_transform(
             f"{self.tag}_root",
-            dpg.create_translation_matrix((px, py)),
+            dpg.create_translation_matrix((px, py))
+            * dpg.create_scale_matrix((scale, scale, 1.0)),
         )
+        self._view_origin = (px, py)
+        self._update_viewport()
 
     def look_at_node(self, node: str) -> None:
         n = self.nodes[node]
         cw, ch = dpg.get_item_rect_size(self.tag)
-        # Not sure why it's -n.pos, but it works
-        px = -n.pos[0] + cw / 2 - n.width / 2
-        py = -n.pos[1] + ch / 2 - n.height / 2
+        scale = self.zoom_factor
+        px = cw / 2 - (n.x + n.width / 2) * scale
+        py = ch / 2 - (n.y + n.height / 2) * scale
         self.set_origin(px, py)
 
     def set_zoom(
@@ -166,11 +185,14 @@ class GraphWidget:
         if limits:
             zoom_level = min(max(zoom_level, self.zoom_min), self.zoom_max)
 
-        if zoom_point is not None:
-            self.set_origin(*zoom_point)
-
         self.zoom_level = zoom_level
-        self.regenerate()
+        self._update_text_sizes()
+
+        if zoom_point is None:
+            zoom_point = self.transform
+
+        # Will update the transform
+        self.set_origin(*zoom_point)
 
     def get_canvas_content_bbox(
         self, margin: float = 50.0
@@ -199,12 +221,7 @@ class GraphWidget:
             self.set_zoom(0, (0.0, 0.0))
             return
 
-        # Temporarily set zoom to 0 to get the base layout without zoom scaling.
-        # Expensive, but reliable
-        self.zoom_level = 0
-        self.regenerate()
-
-        # Get content bounding box at base zoom level
+        # Content bounding box in graph space
         bbox = self.get_canvas_content_bbox()
         content_w = bbox[2]
         content_h = bbox[3]
@@ -241,8 +258,8 @@ class GraphWidget:
 
         # Apply zoom and centering together
         self.zoom_level = zoom_level
+        self._update_text_sizes()
         self.set_origin(new_origin_x, new_origin_y)
-        self.regenerate()
 
     # Content setup
     def _setup_content(self, width: int, height: int):
@@ -285,7 +302,7 @@ class GraphWidget:
         dpg.bind_item_handler_registry(parent, dpg.last_container())
 
     def _on_resize(self, *args):
-        pass
+        self._update_viewport()
 
     # Canvas interactions
     def _get_graph_mouse_pos(self) -> tuple[float, float]:
@@ -295,7 +312,8 @@ class GraphWidget:
 
         mx, my = dpg.get_drawing_mouse_pos()
         ox, oy = self.transform
-        return ((mx - ox), (my - oy))
+        scale = self.zoom_factor
+        return ((mx - ox) / scale, (my - oy) / scale)
 
     def _on_left_click(self) -> None:
         if not dpg.is_item_hovered(self.tag):
@@ -404,11 +422,17 @@ class GraphWidget:
 
         # +/-1 only
         wheel_delta /= abs(wheel_delta)
+        zoom_level = min(max(self.zoom_level + wheel_delta, self.zoom_min), self.zoom_max)
+
+        # Keep the point under the mouse cursor in place
+        mx, my = dpg.get_drawing_mouse_pos()
+        ox, oy = self.transform
+        factor = self.layout.zoom_factor ** (zoom_level - self.zoom_level)
+        zoom_point = (mx - (mx - ox) * factor, my - (my - oy) * factor)
 
         # Scrolling too fast can cause problems
         with dpg.mutex():
-            # Don't set the zoom point, it will just mess things up
-            self.set_zoom(self.zoom_level + wheel_delta)
+            self.set_zoom(zoom_level, zoom_point)
 
     def _on_mouse_move(self) -> None:
         if not self.hover_enabled:
@@ -461,9 +485,7 @@ class GraphWidget:
 
     # Canvas content management
     def clear(self, reset_origin: bool = True):
-        dpg.delete_item(f"{self.tag}_edge_layer", children_only=True)
-        dpg.delete_item(f"{self.tag}_node_layer", children_only=True)
-        self.color_generator.reset()
+        self._clear_canvas()
 
         for node in self.nodes.values():
             node.visible = False
@@ -474,13 +496,29 @@ class GraphWidget:
             self.set_origin(0.0, 0.0)
 
     def regenerate(self):
-        if not self.graph:
-            return
+        # Node contents may have changed
+        self._frontpages.clear()
+        self._redraw()
 
+    def _clear_canvas(self) -> None:
         dpg.delete_item(f"{self.tag}_edge_layer", children_only=True)
         dpg.delete_item(f"{self.tag}_node_layer", children_only=True)
+        self.node_grid.clear()
+        self.edge_grid.clear()
+        self.edges.clear()
+        self._drawn_nodes.clear()
+        self._drawn_edges.clear()
+        self._node_colors.clear()
+        self._hovered_nodes.clear()
+        self.layout.reset()
         self.color_generator.reset()
 
+    def _redraw(self) -> None:
+        if not self.graph:
+            return
+
+        self._clear_canvas()
+
         want_visible = []
         selected = self.selected_node
         self.selected_node = None
@@ -584,9 +622,9 @@ class GraphWidget:
             self.on_node_selected(None)
 
     def clear_highlights(self) -> None:
-        for node in self.nodes.values():
-            if node.visible:
-                dpg.configure_item(f"{self.tag}_node_{node.id}_box", color=style.white)
+        self._node_colors.clear()
+        for node_id in self._drawn_nodes:
+            dpg.configure_item(f"{self.tag}_node_{node_id}_box", color=style.white)
 
     def set_highlight(self, node: Node | str, color: tuple = style.white) -> None:
         if isinstance(node, Node):
@@ -595,7 +633,13 @@ class GraphWidget:
         if node not in self.nodes or not self.nodes[node].visible:
             return
 
-        dpg.configure_item(f"{self.tag}_node_{node}_box", color=color)
+        if color == style.white:
+            self._node_colors.pop(node, None)
+        else:
+            self._node_colors[node] = color
+
+        if node in self._drawn_nodes:
+            dpg.configure_item(f"{self.tag}_node_{node}_box", color=color)
 
     def set_hovered(self, node: Node | str, hovered: bool) -> None:
         if isinstance(node, Node):
@@ -604,8 +648,14 @@ class GraphWidget:
         if node not in self.nodes or not self.nodes[node].visible:
             return
 
-        thickness = 2 if hovered else 1
-        dpg.configure_item(f"{self.tag}_node_{node}_box", thickness=thickness)
+        if hovered:
+            self._hovered_nodes.add(node)
+        else:
+            self._hovered_nodes.discard(node)
+
+        if node in self._drawn_nodes:
+            thickness = 2 if hovered else 1
+            dpg.configure_item(f"{self.tag}_node_{node}_box", thickness=thickness)
 
     def _set_edge_highlight(
         self, node_a: Node | str, node_b: Node | str, highlighted: bool
@@ -676,7 +726,7 @@ class GraphWidget:
             succ.visible = True
             succ.unfolded = True
 
-        self.regenerate()
+        self._redraw()
 
     def reveal_all_nodes(self, max_depth: int = -1) -> None:
         if max_depth == 0:
@@ -688,13 +738,14 @@ class GraphWidget:
                 node.visible = True
                 node.unfolded = True
 
-        self.regenerate()
+        self._redraw()
 
     def _fold_node(self, node: Node) -> None:
         # Set visible status first, otherwise we make mistakes if nodes have multiple parents
         for child_id in self.graph.successors(self.selected_node.id):
             child_node = self.nodes[child_id]
             child_node.visible = False
+            self.layout.on_node_removed(child_node)
 
         # Remove all children without still visible parents
         for child_id in nx.descendants(self.graph, self.selected_node.id):
@@ -707,22 +758,80 @@ class GraphWidget:
 
         node.unfolded = False
 
-    def _draw_node(self, node: Node) -> None:
-        tag = f"{self.tag}_node_{node.id}"
+    def _get_viewport(self, margin: float) -> tuple[float, float, float, float]:
+        # The visible area in graph space
+        cw, ch = dpg.get_item_rect_size(self.tag)
+        if cw <= 0 or ch <= 0:
+            # Canvas not drawn yet
+            return None
 
-        if dpg.does_item_exist(tag):
-            if not node.visible:
-                # Make the item appear in a sensible place
-                node.pos = self.layout.get_pos_for_node(self.graph, node, self.nodes)
-                node.visible = True
-            
-            dpg.show_item(tag)
-            return
+        ox, oy = self._view_origin
+        scale = self.zoom_factor
+        return (
+            (-ox - margin) / scale,
+            (-oy - margin) / scale,
+            (-ox + cw + margin) / scale,
+            (-oy + ch + margin) / scale,
+        )
 
+    def _update_text_sizes(self) -> None:
+        # Transforms don't affect the font size of drawn text, so we have to update
+        # the text items ourselves. Thanks to culling this is limited to the content
+        # close to the viewport.
         scale = self.zoom_factor
-        margin = self.layout.text_margin
-        text_h = 12
-        text_offset_y = text_h * scale
+
+        for node_id in self._drawn_nodes:
+            tag = f"{self.tag}_node_{node_id}"
+            lines = self._frontpages[node_id][0]
+            for i in range(len(lines)):
+                dpg.configure_item(f"{tag}_text_{i}", size=12 * scale)
+
+        for node_a, node_b in self._drawn_edges:
+            label = f"{self.tag}_edge_{node_a}_TO_{node_b}_label_text"
+            if dpg.does_item_exist(label):
+                dpg.configure_item(label, size=11 * scale)
+
+    def _is_in_viewport(self, bbox: tuple[float, float, float, float]) -> bool:
+        view = self._get_viewport(self.viewport_margin)
+        return view is None or bbox_overlap(bbox, view)
+
+    def _update_viewport(self) -> None:
+        view = self._get_viewport(self.viewport_margin)
+        if view is None:
+            return
+
+        # Create draw items for everything that scrolled into view
+        for node_id in self.node_grid.query_rect(view):
+            node = self.nodes.get(node_id)
+            if node and node.visible and node_id not in self._drawn_nodes:
+                self._materialize_node(node)
+
+        for parent_id in self.edge_grid.query_rect(view):
+            for child_id in self.edges[parent_id]:
+                if (parent_id, child_id) not in self._drawn_edges:
+                    self._materialize_edge(self.nodes[parent_id], self.nodes[child_id])
+
+        # Release draw items that are far away. Using a larger margin here avoids
+        # recreating items when moving back and forth.
+        keep = self._get_viewport(self.viewport_margin * 3)
+
+        for node_id in list(self._drawn_nodes):
+            node = self.nodes.get(node_id)
+            if not node or not bbox_overlap(node.bbox, keep):
+                self._dematerialize_node(node_id)
+
+        for edge in list(self._drawn_edges):
+            bbox = self.edge_grid.get_bbox(edge[0])
+            if not bbox or not bbox_overlap(bbox, keep):
+                self._dematerialize_edge(edge)
+
+    def _get_frontpage(
+        self, node: Node
+    ) -> tuple[list[str], list[tuple], tuple[float, float]]:
+        cached = self._frontpages.get(node.id)
+        if cached:
+            return cached
+
         lines = self.get_node_frontpage(node)
         colors = None
 
@@ -736,40 +845,97 @@ class GraphWidget:
 
         max_len = max(len(s) for s in lines)
         lines = [s.center(max_len) for s in lines]
-        w, h = estimate_drawn_text_size(
-            max_len, num_lines=len(lines), font_size=text_h, scale=scale, margin=margin
+
+        # Nodes are drawn in graph space, so we only have to measure the text once
+        size = estimate_drawn_text_size(
+            max_len, num_lines=len(lines), font_size=12, margin=self.layout.text_margin
         )
 
+        cached = (lines, colors, size)
+        self._frontpages[node.id] = cached
+        return cached
+
+    def _draw_node(self, node: Node) -> None:
+        if not node.visible:
+            node.size = self._get_frontpage(node)[2]
+            node.pos = self.layout.get_pos_for_node(self.graph, node, self.nodes)
+            node.visible = True
+            self.node_grid.insert(node.id, node.bbox)
+            self.layout.on_node_placed(node)
+
+            if node.id in self._drawn_nodes:
+                # Hidden nodes may still have their draw items
+                dpg.apply_transform(
+                    f"{self.tag}_node_{node.id}",
+                    dpg.create_translation_matrix([node.x, node.y]),
+                )
+
+        if node.id not in self._drawn_nodes and self._is_in_viewport(node.bbox):
+            self._materialize_node(node)
+
+    def _materialize_node(self, node: Node) -> None:
+        tag = f"{self.tag}_node_{node.id}"
+        scale = self.zoom_factor
+        margin = self.layout.text_margin
+        text_h = 12
+        lines, colors, _ = self._get_frontpage(node)
+        w, h = node.size
+
         with dpg.draw_node(tag=tag, parent=f"{self.tag}_node_layer"):
             # Background
             dpg.draw_rectangle(
                 (0.0, 0.0),
                 (w, h),
                 fill=style.dark_grey,
-                color=style.white,
-                thickness=1,
+                color=self._node_colors.get(node.id, style.white),
+                thickness=2 if node.id in self._hovered_nodes else 1,
                 tag=f"{tag}_box",  # for highlighting
             )
 
             # Text
             for i, text in enumerate(lines):
                 dpg.draw_text(
-                    (margin, margin + text_offset_y * i),
+                    (margin, margin + text_h * i),
                     text,
-                    size=12 * scale,
+                    size=text_h * scale,
                     color=colors[i],
+                    tag=f"{tag}_text_{i}",
                 )
 
-        node.size = (w, h)
-        node.pos = self.layout.get_pos_for_node(self.graph, node, self.nodes)
-        node.visible = True
         dpg.apply_transform(tag, dpg.create_translation_matrix([node.x, node.y]))
+        self._drawn_nodes.add(node.id)
+
+    def _dematerialize_node(self, node_id: str) -> None:
+        if node_id in self._drawn_nodes:
+            dpg.delete_item(f"{self.tag}_node_{node_id}")
+            self._drawn_nodes.discard(node_id)
 
     def _draw_edge(self, node_a: Node, node_b: Node) -> None:
-        tag = f"{self.tag}_edge_{node_a.id}_TO_{node_b.id}"
-        if dpg.does_item_exist(tag):
+        children = self.edges.setdefault(node_a.id, set())
+        if node_b.id in children:
             return
 
+        children.add(node_b.id)
+
+        # Grow the bounding box of all edges starting at node_a
+        a_bbox = self.edge_grid.get_bbox(node_a.id) or node_a.bbox
+        b_bbox = node_b.bbox
+        bbox = (
+            min(a_bbox[0], b_bbox[0]),
+            min(a_bbox[1], b_bbox[1]),
+            max(a_bbox[2], b_bbox[2]),
+            max(a_bbox[3], b_bbox[3]),
+        )
+        if bbox != a_bbox or node_a.id not in self.edge_grid:
+            self.edge_grid.insert(node_a.id, bbox)
+
+        if self._is_in_viewport(bbox):
+            self._materialize_edge(node_a, node_b)
+
+    def _materialize_edge(self, node_a: Node, node_b: Node) -> None:
+        tag = f"{self.tag}_edge_{node_a.id}_TO_{node_b.id}"
+        self._drawn_edges.add((node_a.id, node_b.id))
+
         if self.rainbow_edges:
             color = self.color_generator(node_a.id)
             color = tuple((c + 255) // 2 for c in color)
@@ -820,7 +986,7 @@ class GraphWidget:
                 scale = self.zoom_factor
 
                 tw, th = estimate_drawn_text_size(
-                    len(label), font_size=11, scale=scale, margin=margin
+                    len(label), font_size=11, margin=margin
                 )
                 tx = (ax + bx) / 2 - tw / 2
                 ty = (ay + by) / 2 - th * 2 / 5
@@ -843,12 +1009,24 @@ class GraphWidget:
                         label,
                         size=11 * scale,
                         color=color,
+                        tag=f"{tag}_label_text",
                     )
 
                 dpg.apply_transform(
                     f"{tag}_label", dpg.create_translation_matrix((tx, ty))
                 )
 
+    def _dematerialize_edge(self, edge: tuple[str, str]) -> None:
+        if edge not in self._drawn_edges:
+            return
+
+        tag = f"{self.tag}_edge_{edge[0]}_TO_{edge[1]}"
+        dpg.delete_item(tag)
+        if dpg.does_item_exist(f"{tag}_label"):
+            dpg.delete_item(f"{tag}_label")
+
+        self._drawn_edges.discard(edge)
+
     def _remove_from_canvas(self, node: Node) -> None:
         if not node:
             return
@@ -857,11 +1035,19 @@ class GraphWidget:
             child_node = self.nodes.get(child_id, None)
             self._remove_from_canvas(child_node)
 
-        dpg.delete_item(f"{self.tag}_node_{node.id}")
+        self._dematerialize_node(node.id)
+        self.node_grid.remove(node.id)
+        self.layout.on_node_removed(node)
         node.visible = False
         node.unfolded = False
 
         # Delete relations
         for parent_id in self.graph.predecessors(node.id):
-            if dpg.does_item_exist(f"{self.tag}_edge_{parent_id}_TO_{node.id}"):
-                dpg.delete_item(f"{self.tag}_edge_{parent_id}_TO_{node.id}")
+            self._dematerialize_edge((parent_id, node.id))
+
+            children = self.edges.get(parent_id)
+            if children:
+                children.discard(node.id)
+                if not children:
+                    del self.edges[parent_id]
+                    self.edge_grid.remove(parent_id)
@@ -1,10 +1,12 @@
 from typing import Callable
+import math
 import dearpygui.dearpygui as dpg
 import numpy as np
 import networkx as nx
 from pykdtree.kdtree import KDTree
 
 from hkb_editor.gui import style
+from .graphmap_layout import MultipartiteLayout, get_layout
 
 
 class GraphMap:
@@ -14,21 +16,35 @@ class GraphMap:
         get_node_data: Callable[[str], list[str | tuple[str]]],
         on_click_callback: Callable[[str], None],
         tag: str,
+        cache_file: str = None,
     ):
         self.graph: nx.DiGraph = None
         self.get_node_data = get_node_data
         self.on_click_callback = on_click_callback
         self.callback_triggered = False
         self.tag = tag
+        self.cache_file = cache_file
 
         self._nodes: list[str] = []
+        self._node_indices: dict[str, int] = {}
         self._node_radius = 10
+        self._marker_size = 3
         self._max_tooltip_lines = 6
         self._graph_extends: tuple[float, float] = None
         self._node_lookup: KDTree = None
+        self._layout: MultipartiteLayout = None
         self._highlighted_node = None
         self._handler_tag = f"{self.tag}_handlers"
 
+        # Geometry is kept in numpy arrays and rendered as a few plot series. When zoomed
+        # out, nodes are aggregated on a grid so that each cell is drawn only once.
+        self._positions: np.ndarray = None
+        self._edges: np.ndarray = None
+        self._lod_min_nodes = 2000
+        self._lod_pixels = 4.0
+        self._lod_level: int = None
+        self._lod_cache: dict[int, tuple[np.ndarray, np.ndarray]] = {}
+
         self._setup_content()
         self.set_graph(graph)
 
@@ -46,8 +62,9 @@ class GraphMap:
             dpg.configure_item(registry_tag, show=False)
 
         # Delete the drawable content
-        if dpg.does_item_exist(self.tag):
-            dpg.delete_item(self.tag)
+        for item in (self.tag, f"{self.tag}_tooltip", *self._themes):
+            if dpg.does_item_exist(item):
+                dpg.delete_item(item)
 
         # Schedule handler registry deletion for later, otherwise this can sometimes lead
         # to silent program crashes. This is the only solution I have found to this.
@@ -67,7 +84,41 @@ class GraphMap:
         if dpg.does_item_exist(self._handler_tag):
             dpg.delete_item(self._handler_tag)
 
+    def _make_series_theme(
+        self, series_type: int, color: style.RGBA, marker_size: float = None
+    ) -> str:
+        with dpg.theme() as theme:
+            with dpg.theme_component(series_type):
+                dpg.add_theme_color(
+                    dpg.mvPlotCol_Line, color, category=dpg.mvThemeCat_Plots
+                )
+
+                if marker_size is not None:
+                    dpg.add_theme_color(
+                        dpg.mvPlotCol_MarkerFill, color, category=dpg.mvThemeCat_Plots
+                    )
+                    dpg.add_theme_color(
+                        dpg.mvPlotCol_MarkerOutline,
+                        color,
+                        category=dpg.mvThemeCat_Plots,
+                    )
+                    dpg.add_theme_style(
+                        dpg.mvPlotStyleVar_Marker,
+                        dpg.mvPlotMarker_Circle,
+                        category=dpg.mvThemeCat_Plots,
+                    )
+                    dpg.add_theme_style(
+                        dpg.mvPlotStyleVar_MarkerSize,
+                        marker_size,
+                        category=dpg.mvThemeCat_Plots,
+                    )
+
+        self._themes.append(theme)
+        return theme
+
     def _setup_content(self) -> None:
+        self._themes = []
+
         with dpg.group(tag=self.tag):
             with dpg.plot(
                 width=-1,
@@ -87,7 +138,7 @@ class GraphMap:
                     no_menus=True,
                     tag=f"{self.tag}_x_axis",
                 )
-                dpg.add_plot_axis(
+                with dpg.plot_axis(
                     dpg.mvYAxis,
                     show=True,
                     #no_highlight=True,
@@ -95,8 +146,47 @@ class GraphMap:
                     no_tick_labels=True,
                     no_menus=True,
                     tag=f"{self.tag}_y_axis",
-                )
-                    
+                ):
+                    # Edges first so they render below the nodes. Each series is a
+                    # single batch, edges are drawn as line segments between
+                    # consecutive point pairs.
+                    dpg.add_line_series(
+                        [], [], segments=True, tag=f"{self.tag}_edges"
+                    )
+                    dpg.add_scatter_series([], [], tag=f"{self.tag}_nodes")
+                    dpg.add_line_series(
+                        [], [], segments=True, tag=f"{self.tag}_highlight_edges"
+                    )
+                    dpg.add_scatter_series([], [], tag=f"{self.tag}_highlight_node")
+
+        line_theme = self._make_series_theme(dpg.mvLineSeries, style.white)
+        dpg.bind_item_theme(f"{self.tag}_edges", line_theme)
+
+        node_theme = self._make_series_theme(
+            dpg.mvScatterSeries, style.white, self._marker_size
+        )
+        dpg.bind_item_theme(f"{self.tag}_nodes", node_theme)
+
+        highlight_line_theme = self._make_series_theme(dpg.mvLineSeries, style.orange)
+        dpg.bind_item_theme(f"{self.tag}_highlight_edges", highlight_line_theme)
+
+        highlight_node_theme = self._make_series_theme(
+            dpg.mvScatterSeries, style.orange, self._marker_size * 2
+        )
+        dpg.bind_item_theme(f"{self.tag}_highlight_node", highlight_node_theme)
+
+        dpg.add_window(
+            autosize=True,
+            no_title_bar=True,
+            no_move=True,
+            no_resize=True,
+            no_scrollbar=True,
+            no_saved_settings=True,
+            no_focus_on_appearing=True,
+            show=False,
+            tag=f"{self.tag}_tooltip",
+        )
+
         # handlers
         if not dpg.does_item_exist(self._handler_tag):
             dpg.add_handler_registry(tag=self._handler_tag)
@@ -108,13 +198,18 @@ class GraphMap:
             button=dpg.mvMouseButton_Left,
             callback=self._on_mouse_click, parent=self._handler_tag,
         )
+        dpg.add_mouse_wheel_handler(
+            callback=self._on_mouse_wheel, parent=self._handler_tag
+        )
 
     def get_node_at(self, pos: tuple[float, float]) -> str:
         if self._node_lookup:
+            # When zoomed out nodes are drawn at their cell's center
+            max_dist = max(self._node_radius / 2, self._get_lod_cell_size(self._lod_level))
             dist, idx = self._node_lookup.query(
                 np.array([pos]),
                 k=1,
-                distance_upper_bound=self._node_radius / 2,
+                distance_upper_bound=max_dist,
             )
             if dist < np.inf:
                 return self._nodes[int(idx[0])]
@@ -137,122 +232,161 @@ class GraphMap:
             extends[1] / self._graph_extends[1],
         )
 
-    def set_graph(self, graph: nx.DiGraph) -> None:
+    def set_graph(self, graph: nx.DiGraph, cache_file: str = None) -> None:
         self.graph = graph
-        self._nodes: list[str] = sorted(graph.nodes)
-        # TODO Performance seems to be okayish up until ~1000 nodes
-        print(f"Rendering {len(self._nodes)} nodes...")
-
-        # Need to create a new series due to the bug mentioned below
-        dpg.delete_item(f"{self.tag}_x_axis", children_only=True)
-        dpg.split_frame()
-
-        num_nodes = len(self._nodes)
-        with dpg.custom_series(
-            # Note: there is a bug in current dearpygui where updating the series data
-            # does not update how many items of transformed_x/y it will provide
-            [0] * num_nodes,
-            [0] * num_nodes,
-            2,
-            callback=self._render,
-            tag=f"{self.tag}_series",
-            parent=f"{self.tag}_x_axis",
-        ):
-            # Tooltip
-            # NOTE creating a group/child window and adding children later doesn't work
-            # NOTE placing widgets inside groups/child windows here will make them 
-            # impossible to change
-            for i in range(self._max_tooltip_lines):
-                dpg.add_text("hello", tag=f"{self.tag}_plot_tooltip_line{i}")
+        self._highlighted_node = None
 
+        if cache_file:
+            self.cache_file = cache_file
 
         self.regenerate()
         dpg.fit_axis_data(f"{self.tag}_x_axis")
         dpg.fit_axis_data(f"{self.tag}_y_axis")
 
+        # Axis limits are only updated on the next frame
+        dpg.set_frame_callback(dpg.get_frame_count() + 1, self._update_lod)
+
     def regenerate(self) -> None:
         if not self.graph:
             return
-        
-        dpg.delete_item(f"{self.tag}_plot", children_only=True, slot=2)
-
-        # Use a map so that we can control the order of nodes in each layer
-        layers = {}
-        max_layer_nodes = 0
-        for layer, nodes in enumerate(nx.topological_generations(self.graph)):
-            max_layer_nodes = max(len(nodes), max_layer_nodes)
-            layers[layer] = sorted(nodes)
-
-        # TODO use this for our main layout, too
-        pos = nx.multipartite_layout(self.graph, subset_key=layers, scale=100)
-        # Be sure to use a consistent order of nodes
-        points = np.vstack(list(pos[n] for n in self._nodes))
-        self._node_lookup = KDTree(points)
-
-        x_data, y_data = list(zip(*[pos[n] for n in self._nodes]))
-        dpg.set_value(f"{self.tag}_series", [x_data, y_data])
-
-        x_min = min(x_data)
-        x_max = max(x_data)
-        y_min = min(y_data)
-        y_max = max(y_data)
-        self._graph_extends = (x_max - x_min, y_max - y_min)
-
-    def _render(self, sender: str, app_data: list) -> None:
-        if not self.graph:
+
+        # Layouts are cached by graph structure, small changes are applied incrementally
+        previous = [self._layout] if self._layout else []
+        self._layout = get_layout(self.graph, self.cache_file, previous)
+
+        self._nodes = self._layout.nodes
+        self._node_indices = {n: i for i, n in enumerate(self._nodes)}
+        self._positions = self._layout.positions
+        self._edges = np.array(
+            [
+                (self._node_indices[a], self._node_indices[b])
+                for a, b in self.graph.edges
+            ],
+            dtype=np.int64,
+        ).reshape(-1, 2)
+        self._node_lookup = self._layout.lookup
+
+        extends = self._positions.max(axis=0) - self._positions.min(axis=0)
+        self._graph_extends = (float(extends[0]), float(extends[1]))
+
+        self._lod_cache.clear()
+        self._lod_level = None
+        self._update_lod(force=True)
+        self.set_highlighted_node(None)
+
+    def _get_lod_level(self) -> int:
+        if len(self._nodes) < self._lod_min_nodes or not self._graph_extends:
+            return 0
+
+        # Aggregate nodes closer than a few pixels
+        x_limits = dpg.get_axis_limits(f"{self.tag}_x_axis")
+        y_limits = dpg.get_axis_limits(f"{self.tag}_y_axis")
+        plot_w, plot_h = dpg.get_item_rect_size(f"{self.tag}_plot")
+        if plot_w <= 0 or plot_h <= 0:
+            return 0
+
+        units_per_pixel = max(
+            (x_limits[1] - x_limits[0]) / plot_w,
+            (y_limits[1] - y_limits[0]) / plot_h,
+        )
+        cell_size = units_per_pixel * self._lod_pixels
+        base = self._get_lod_cell_size(1)
+
+        if cell_size < base:
+            return 0
+
+        # Power of 2 steps so that zooming doesn't recalculate constantly
+        return int(math.log2(cell_size / base)) + 1
+
+    def _get_lod_cell_size(self, level: int) -> float:
+        if not level or not self._graph_extends:
+            return 0.0
+
+        base = max(self._graph_extends) / 4096
+        return base * 2 ** (level - 1)
+
+    def _get_lod_geometry(self, level: int) -> tuple[np.ndarray, np.ndarray]:
+        # Returns the node positions and edges as pairs of node indices
+        if level == 0:
+            return self._positions, self._edges
+
+        cached = self._lod_cache.get(level)
+        if cached:
+            return cached
+
+        # Nodes in the same grid cell are merged into their centroid
+        cell_size = self._get_lod_cell_size(level)
+        cells = np.floor(
+            (self._positions - self._positions.min(axis=0)) / cell_size
+        ).astype(np.int64)
+        _, cluster, counts = np.unique(
+            cells, axis=0, return_inverse=True, return_counts=True
+        )
+        cluster = cluster.reshape(-1)
+
+        positions = np.column_stack(
+            [
+                np.bincount(cluster, weights=self._positions[:, 0]) / counts,
+                np.bincount(cluster, weights=self._positions[:, 1]) / counts,
+            ]
+        )
+
+        # Only keep one edge per pair of cells
+        edges = cluster[self._edges]
+        edges = edges[edges[:, 0] != edges[:, 1]]
+        if len(edges):
+            edges = np.unique(edges, axis=0)
+
+        self._lod_cache[level] = (positions, edges)
+        return positions, edges
+
+    def _update_lod(self, *args, force: bool = False) -> None:
+        if self._positions is None:
             return
 
-        transformed_x = app_data[1]
-        transformed_y = app_data[2]
-        node_indices = {n: i for i, n in enumerate(self._nodes)}
-        scale = 1 / max(*self.get_zoom())
-
-        def get_pos(node: str):
-            idx = node_indices[node]
-            return transformed_x[idx], transformed_y[idx]
-
-        dpg.push_container_stack(sender)
-
-        # Edges first so they render below the nodes
-        for node0, node1 in self.graph.edges:
-            edge_tag = f"{self.tag}_edge_{node0}_TO_{node1}"
-            if dpg.does_item_exist(edge_tag):
-                dpg.configure_item(edge_tag, p1=get_pos(node0), p2=get_pos(node1))
-            else:
-                dpg.draw_line(
-                    get_pos(node0),
-                    get_pos(node1),
-                    color=style.white,
-                    tag=edge_tag,
-                )
+        level = self._get_lod_level()
+        if level == self._lod_level and not force:
+            return
 
-        for node in self._nodes:
-            node_tag = f"{self.tag}_node_{node}"
-            if dpg.does_item_exist(node_tag):
-                # TODO scale
-                dpg.configure_item(node_tag, center=get_pos(node), radius=self._node_radius * scale)
-            else:
-                dpg.draw_circle(
-                    get_pos(node),
-                    radius=self._node_radius * scale,
-                    color=style.white,
-                    fill=style.white,
-                    tag=node_tag,
-                )
+        self._lod_level = level
+        positions, edges = self._get_lod_geometry(level)
+
+        x_data, y_data = self._get_segments(positions, edges)
+        dpg.set_value(f"{self.tag}_edges", [x_data, y_data])
+        dpg.set_value(
+            f"{self.tag}_nodes",
+            [positions[:, 0].tolist(), positions[:, 1].tolist()],
+        )
 
-        dpg.pop_container_stack()
+    def _get_segments(
+        self, positions: np.ndarray, edges: np.ndarray
+    ) -> tuple[list[float], list[float]]:
+        # Interleave start and end points of all edges
+        points = positions[edges.reshape(-1)]
+        return points[:, 0].tolist(), points[:, 1].tolist()
+
+    def _on_mouse_wheel(self) -> None:
+        if not dpg.is_item_hovered(f"{self.tag}_plot"):
+            return
+
+        # Axis limits are only updated on the next frame
+        dpg.set_frame_callback(dpg.get_frame_count() + 1, self._update_lod)
 
     def _on_mouse_move(self) -> None:
         if not self._node_lookup:
             return
 
         if not dpg.is_item_hovered(f"{self.tag}_plot"):
+            dpg.hide_item(f"{self.tag}_tooltip")
             return
 
+        # Catch zooming that didn't go through the mouse wheel, e.g. double clicks
+        self._update_lod()
+
         pos = dpg.get_plot_mouse_pos()
         node = self.get_node_at(pos)
-        self.set_highlighted_node(node)
         self._update_hover_text(node)
+        self.set_highlighted_node(node)
 
     def _on_mouse_click(self) -> None:
         if not self._node_lookup or not self.on_click_callback:
@@ -266,7 +400,7 @@ class GraphMap:
 
         # The callback can take a while to resolve, make sure we handle the user's impatience :)
         self.callback_triggered = True
-        
+
         pos = dpg.get_plot_mouse_pos()
         node = self.get_node_at(pos)
         if node:
@@ -275,59 +409,50 @@ class GraphMap:
         self.callback_triggered = False
 
     def set_highlighted_node(self, node: str) -> None:
-        if self._highlighted_node and self._highlighted_node != node:
-            dpg.configure_item(
-                f"{self.tag}_node_{self._highlighted_node}", color=style.white
-            )
-
-            for node1 in nx.all_neighbors(self.graph, self._highlighted_node):
-                if node1 != self._highlighted_node:
-                    self._set_edge_highlight(self._highlighted_node, node1, False)
-
-        if node and node != self._highlighted_node:
-            dpg.configure_item(f"{self.tag}_node_{node}", color=style.orange)
-
-            for node1 in nx.all_neighbors(self.graph, node):
-                if node1 != node:
-                    self._set_edge_highlight(node, node1, True)
+        if node == self._highlighted_node:
+            return
 
         self._highlighted_node = node
 
-    def _set_edge_highlight(self, node_a: str, node_b: str, highlighted: bool) -> None:
-        tag = f"{self.tag}_edge_{node_a}_TO_{node_b}"
-        if not dpg.does_item_exist(tag):
-            tag = f"{self.tag}_edge_{node_b}_TO_{node_a}"
-
-        if not dpg.does_item_exist(tag):
+        if not node or node not in self._node_indices:
+            dpg.set_value(f"{self.tag}_highlight_node", [[], []])
+            dpg.set_value(f"{self.tag}_highlight_edges", [[], []])
             return
 
-        thickness = 2 if highlighted else 1
-        color = style.orange if highlighted else style.white
-        dpg.configure_item(tag, thickness=thickness, color=color)
+        # Highlights always use the real positions, even when zoomed out
+        idx = self._node_indices[node]
+        neighbors = [
+            self._node_indices[n]
+            for n in nx.all_neighbors(self.graph, node)
+            if n != node
+        ]
+        edges = np.array([(idx, n) for n in neighbors], dtype=np.int64).reshape(-1, 2)
+
+        x, y = self._positions[idx]
+        dpg.set_value(f"{self.tag}_highlight_node", [[float(x)], [float(y)]])
+        dpg.set_value(
+            f"{self.tag}_highlight_edges", list(self._get_segments(self._positions, edges))
+        )
 
     def _update_hover_text(self, node: str) -> None:
+        tooltip = f"{self.tag}_tooltip"
+
         if node:
-            lines = self.get_node_data(node)
-            if isinstance(lines, str):
-                lines = [lines]
-            elif isinstance(lines[0], tuple):
-                lines, colors = zip(*lines)
-
-            if not colors:
-                colors = [style.white] * len(lines)
-
-            for i in range(self._max_tooltip_lines):
-                if i < len(lines):
-                    dpg.configure_item(
-                        f"{self.tag}_plot_tooltip_line{i}",
-                        default_value=lines[i],
-                        color=colors[i],
-                    )
-                    # configure(show=True) doesn't work
-                    dpg.show_item(f"{self.tag}_plot_tooltip_line{i}")
-                else:
-                    dpg.hide_item(f"{self.tag}_plot_tooltip_line{i}")
-            
-            dpg.configure_item(f"{self.tag}_series", tooltip=True)
+            if node != self._highlighted_node:
+                dpg.delete_item(tooltip, children_only=True)
+
+                lines = self.get_node_data(node)
+                if isinstance(lines, str):
+                    lines = [lines]
+
+                for line in lines[: self._max_tooltip_lines]:
+                    color = style.white
+                    if isinstance(line, tuple):
+                        line, color = line
+                    dpg.add_text(line, color=color, parent=tooltip)
+
+            mx, my = dpg.get_mouse_pos()
+            dpg.set_item_pos(tooltip, (mx + 20, my + 20))
+            dpg.show_item(tooltip)
         else:
-            dpg.configure_item(f"{self.tag}_series", tooltip=False)
+            dpg.hide_item(tooltip)
@@ -0,0 +1,276 @@
+from typing import Iterable
+import os
+import logging
+from collections import OrderedDict
+from dataclasses import dataclass, field
+from hashlib import blake2b
+import numpy as np
+import networkx as nx
+from pykdtree.kdtree import KDTree
+
+
+_logger = logging.getLogger("graphmap")
+
+# Layouts calculated during this session, most recently used last
+_memory_cache: OrderedDict[str, "MultipartiteLayout"] = OrderedDict()
+_memory_cache_size = 4
+
+
+@dataclass
+class MultipartiteLayout:
+    """Node positions of a graph arranged in columns by topological generation.
+
+    Parameters
+    ----------
+    graph_hash : str
+        Structural hash of the graph this layout was calculated for, see `get_graph_hash`.
+    nodes : list[str]
+        The graph's nodes in the order of `positions`.
+    positions : np.ndarray
+        Array of shape (n, 2) with the position of each node.
+    layers : np.ndarray
+        The topological generation of each node.
+    """
+
+    graph_hash: str
+    nodes: list[str]
+    positions: np.ndarray
+    layers: np.ndarray
+    _lookup: KDTree = field(default=None, init=False, repr=False)
+
+    @property
+    def lookup(self) -> KDTree:
+        if self._lookup is None:
+            self._lookup = KDTree(self.positions)
+        return self._lookup
+
+
+def get_graph_hash(graph: nx.DiGraph) -> str:
+    """Calculate a hash over the nodes and edges of a graph. Node and edge attributes are ignored.
+
+    Parameters
+    ----------
+    graph : nx.DiGraph
+        The graph to hash.
+
+    Returns
+    -------
+    str
+        Hex digest of the graph's structure.
+    """
+    h = blake2b(digest_size=16)
+    for node in sorted(graph.nodes):
+        children = ",".join(sorted(graph.successors(node)))
+        h.update(f"{node}>{children}\n".encode())
+
+    return h.hexdigest()
+
+
+def _get_layers(graph: nx.DiGraph) -> list[list[str]]:
+    return [sorted(nodes) for nodes in nx.topological_generations(graph)]
+
+
+def compute_layout(
+    graph: nx.DiGraph, scale: float = 100, graph_hash: str = None
+) -> MultipartiteLayout:
+    """Calculate a new multipartite layout from scratch.
+
+    Parameters
+    ----------
+    graph : nx.DiGraph
+        The graph to arrange. Must be acyclic.
+    scale : float, optional
+        Scale of the layout, see `nx.multipartite_layout`.
+    graph_hash : str, optional
+        Structural hash of the graph if it is already known.
+
+    Returns
+    -------
+    MultipartiteLayout
+        The new layout.
+    """
+    if graph_hash is None:
+        graph_hash = get_graph_hash(graph)
+
+    # Use a map so that we can control the order of nodes in each layer
+    layers = dict(enumerate(_get_layers(graph)))
+    pos = nx.multipartite_layout(graph, subset_key=layers, scale=scale)
+
+    # Be sure to use a consistent order of nodes
+    nodes = sorted(graph.nodes)
+    node_layers = {n: layer for layer, members in layers.items() for n in members}
+
+    return MultipartiteLayout(
+        graph_hash,
+        nodes,
+        np.array([pos[n] for n in nodes], dtype=np.float64).reshape(-1, 2),
+        np.array([node_layers[n] for n in nodes], dtype=np.int32),
+    )
+
+
+def update_layout(
+    previous: MultipartiteLayout,
+    graph: nx.DiGraph,
+    max_changed: float = 0.1,
+    graph_hash: str = None,
+) -> MultipartiteLayout:
+    """Adapt an existing layout to a modified graph. Nodes that are still in the same layer keep their position, new nodes and nodes that changed their layer are appended at the end of their layer's column.
+
+    Parameters
+    ----------
+    previous : MultipartiteLayout
+        The layout of the graph before it was modified.
+    graph : nx.DiGraph
+        The modified graph.
+    max_changed : float, optional
+        If more than this fraction of nodes would have to be placed anew, the layout is not updated.
+    graph_hash : str, optional
+        Structural hash of the graph if it is already known.
+
+    Returns
+    -------
+    MultipartiteLayout
+        The updated layout, or None if the graph changed too much.
+    """
+    if graph_hash is None:
+        graph_hash = get_graph_hash(graph)
+
+    if len(previous.nodes) == 0:
+        return None
+
+    layers = _get_layers(graph)
+    nodes = sorted(graph.nodes)
+    node_layers = {n: layer for layer, members in enumerate(layers) for n in members}
+    layer_ids = np.array([node_layers[n] for n in nodes], dtype=np.int32)
+
+    # Index of each node in the previous layout, -1 for new nodes
+    previous_index = {n: i for i, n in enumerate(previous.nodes)}
+    prev_idx = np.array([previous_index.get(n, -1) for n in nodes], dtype=np.int64)
+    kept = prev_idx >= 0
+    kept[kept] = previous.layers[prev_idx[kept]] == layer_ids[kept]
+
+    misplaced = np.flatnonzero(~kept)
+    if len(misplaced) > max_changed * len(nodes):
+        return None
+
+    positions = np.zeros((len(nodes), 2), dtype=np.float64)
+    positions[kept] = previous.positions[prev_idx[kept]]
+
+    # Column positions and spacing of the previous layout
+    num_layers = max(int(previous.layers.max()), int(layer_ids.max(initial=0))) + 1
+    columns = np.full(num_layers, np.nan)
+    columns[previous.layers] = previous.positions[:, 0]
+    column_ends = np.full(num_layers, -np.inf)
+    np.maximum.at(column_ends, previous.layers, previous.positions[:, 1])
+
+    known = np.flatnonzero(~np.isnan(columns))
+    x_step = 1.0
+    if len(known) > 1:
+        x_step = (columns[known[-1]] - columns[known[0]]) / (known[-1] - known[0])
+
+    ys = np.sort(previous.positions[:, 1])
+    y_step = float(np.median(np.diff(ys))) if len(ys) > 1 else 0.0
+    if y_step <= 0:
+        y_step = x_step
+
+    for i in misplaced:
+        layer = layer_ids[i]
+        if np.isnan(columns[layer]):
+            columns[layer] = columns[known[0]] + (layer - known[0]) * x_step
+
+        if np.isinf(column_ends[layer]):
+            column_ends[layer] = 0.0
+        else:
+            column_ends[layer] += y_step
+
+        positions[i] = (columns[layer], column_ends[layer])
+
+    return MultipartiteLayout(graph_hash, nodes, positions, layer_ids)
+
+
+def save_layout(layout: MultipartiteLayout, file_path: str) -> None:
+    with open(file_path, "wb") as f:
+        np.savez(
+            f,
+            graph_hash=np.array(layout.graph_hash),
+            nodes=np.array(layout.nodes, dtype=str),
+            positions=layout.positions,
+            layers=layout.layers,
+        )
+
+
+def load_layout(file_path: str) -> MultipartiteLayout:
+    with np.load(file_path, allow_pickle=False) as data:
+        return MultipartiteLayout(
+            str(data["graph_hash"]),
+            data["nodes"].tolist(),
+            data["positions"],
+            data["layers"],
+        )
+
+
+def _remember(layout: MultipartiteLayout) -> None:
+    _memory_cache[layout.graph_hash] = layout
+    _memory_cache.move_to_end(layout.graph_hash)
+    while len(_memory_cache) > _memory_cache_size:
+        _memory_cache.popitem(last=False)
+
+
+def get_layout(
+    graph: nx.DiGraph,
+    cache_file: str = None,
+    previous: Iterable[MultipartiteLayout] = (),
+) -> MultipartiteLayout:
+    """Get the layout of a graph, reusing earlier results where possible. Layouts are looked up by the graph's structural hash in memory and in the cache file. If neither matches, a known layout is updated incrementally before falling back to calculating a new one.
+
+    Parameters
+    ----------
+    graph : nx.DiGraph
+        The graph to arrange.
+    cache_file : str, optional
+        File to load the layout from and to store new layouts in.
+    previous : Iterable[MultipartiteLayout], optional
+        Layouts of earlier versions of the graph which may be updated.
+
+    Returns
+    -------
+    MultipartiteLayout
+        The graph's layout.
+    """
+    graph_hash = get_graph_hash(graph)
+
+    layout = _memory_cache.get(graph_hash)
+    if layout:
+        _memory_cache.move_to_end(graph_hash)
+        return layout
+
+    candidates = list(previous)
+    if cache_file and os.path.isfile(cache_file):
+        try:
+            stored = load_layout(cache_file)
+        except Exception as e:
+            _logger.warning(f"Could not load layout cache {cache_file}: {e}")
+        else:
+            if stored.graph_hash == graph_hash:
+                _remember(stored)
+                return stored
+            candidates.append(stored)
+
+    layout = None
+    for candidate in candidates:
+        layout = update_layout(candidate, graph, graph_hash=graph_hash)
+        if layout:
+            break
+
+    if not layout:
+        layout = compute_layout(graph, graph_hash=graph_hash)
+
+    _remember(layout)
+
+    if cache_file:
+        try:
+            save_layout(layout, cache_file)
+        except OSError as e:
+            _logger.warning(f"Could not write layout cache {cache_file}: {e}")
+
+    return layout
@@ -0,0 +1,136 @@
+from typing import Generator, Hashable
+import math
+
+
+class SpatialGrid:
+    """Uniform grid over axis aligned bounding boxes for fast point queries.
+
+    Every item is registered in all cells its bounding box overlaps, so a point query only has to check the items of a single cell. Inserting and removing items is proportional to the number of cells they cover.
+
+    Parameters
+    ----------
+    cell_size : float | tuple[float, float], optional
+        Edge length of the grid cells, or their width and height. Should be roughly the size of a typical item.
+    """
+
+    def __init__(self, cell_size: float | tuple[float, float] = 200.0):
+        if not isinstance(cell_size, tuple):
+            cell_size = (cell_size, cell_size)
+
+        self.cell_size = cell_size
+        self._cells: dict[tuple[int, int], set[Hashable]] = {}
+        self._item_cells: dict[Hashable, list[tuple[int, int]]] = {}
+        self._bboxes: dict[Hashable, tuple[float, float, float, float]] = {}
+
+    def __len__(self) -> int:
+        return len(self._item_cells)
+
+    def __contains__(self, key: Hashable) -> bool:
+        return key in self._item_cells
+
+    def clear(self) -> None:
+        self._cells.clear()
+        self._item_cells.clear()
+        self._bboxes.clear()
+
+    def get_bbox(self, key: Hashable) -> tuple[float, float, float, float]:
+        return self._bboxes.get(key)
+
+    def insert(
+        self, key: Hashable, bbox: tuple[float, float, float, float]
+    ) -> None:
+        """Add an item or update its bounding box.
+
+        Parameters
+        ----------
+        key : Hashable
+            Key to identify the item by.
+        bbox : tuple[float, float, float, float]
+            Bounding box of the item as (x_min, y_min, x_max, y_max).
+        """
+        self.remove(key)
+
+        x0, y0, x1, y1 = bbox
+        cx0, cy0 = self._cell_at(x0, y0)
+        cx1, cy1 = self._cell_at(x1, y1)
+
+        cells = [
+            (cx, cy) for cx in range(cx0, cx1 + 1) for cy in range(cy0, cy1 + 1)
+        ]
+        for cell in cells:
+            self._cells.setdefault(cell, set()).add(key)
+
+        self._item_cells[key] = cells
+        self._bboxes[key] = bbox
+
+    def remove(self, key: Hashable) -> None:
+        cells = self._item_cells.pop(key, None)
+        if not cells:
+            return
+
+        del self._bboxes[key]
+
+        for cell in cells:
+            items = self._cells[cell]
+            items.discard(key)
+            if not items:
+                del self._cells[cell]
+
+    def query(self, x: float, y: float) -> Generator[Hashable, None, None]:
+        """Yield all items whose cells contain the specified point. The caller should check whether the point is actually inside the items.
+
+        Parameters
+        ----------
+        x : float
+            X coordinate of the point.
+        y : float
+            Y coordinate of the point.
+
+        Yields
+        ------
+        Hashable
+            Keys of candidate items.
+        """
+        yield from self._cells.get(self._cell_at(x, y), ())
+
+    def query_rect(self, bbox: tuple[float, float, float, float]) -> set[Hashable]:
+        """Return all items whose bounding box intersects the specified rectangle.
+
+        Parameters
+        ----------
+        bbox : tuple[float, float, float, float]
+            The rectangle as (x_min, y_min, x_max, y_max).
+
+        Returns
+        -------
+        set[Hashable]
+            Keys of all intersecting items.
+        """
+        x0, y0, x1, y1 = bbox
+        cx0, cy0 = self._cell_at(x0, y0)
+        cx1, cy1 = self._cell_at(x1, y1)
+
+        candidates = set()
+        if (cx1 - cx0 + 1) * (cy1 - cy0 + 1) > len(self._cells):
+            # Cheaper to check the occupied cells than all cells in the rectangle
+            for (cx, cy), items in self._cells.items():
+                if cx0 <= cx <= cx1 and cy0 <= cy <= cy1:
+                    candidates.update(items)
+        else:
+            for cx in range(cx0, cx1 + 1):
+                for cy in range(cy0, cy1 + 1):
+                    candidates.update(self._cells.get((cx, cy), ()))
+
+        return {key for key in candidates if bbox_overlap(self._bboxes[key], bbox)}
+
+    def _cell_at(self, x: float, y: float) -> tuple[int, int]:
+        return (
+            math.floor(x / self.cell_size[0]),
+            math.floor(y / self.cell_size[1]),
+        )
+
+
+def bbox_overlap(
+    a: tuple[float, float, float, float], b: tuple[float, float, float, float]
+) -> bool:
+    return a[0] <= b[2] and b[0] <= a[2] and a[1] <= b[3] and b[1] <= a[3]
@@ -289,6 +289,7 @@ def add_lazy_table_tree_node(
     table: str = None,
     tag: str = 0,
     before: str = 0,
+    fold_callback: Callable[[], None] = None,
 ) -> str:
     if not table:
         table = dpg.top_container_stack()
@@ -304,7 +305,7 @@ def add_lazy_table_tree_node(
         tag=tag,
         callback=_on_lazy_node_clicked,
         before=before,
-        user_data=(_lazy_node_sentinel, table, content_callback),
+        user_data=(_lazy_node_sentinel, table, content_callback, fold_callback),
     ) as node:
         pass
 
@@ -351,7 +352,7 @@ def _on_lazy_node_clicked(
     expanded: bool,
     user_data: tuple,
 ):
-    _, table, content_callback = user_data
+    _, table, content_callback, fold_callback = user_data
 
     anchor = get_next_foldable_row_sibling(table, tree_node_row)
     indent_level = get_row_level(tree_node_row) + 1
@@ -371,3 +372,6 @@ def _on_lazy_node_clicked(
                 break
 
             dpg.delete_item(child_row)
+
+        if fold_callback:
+            fold_callback()
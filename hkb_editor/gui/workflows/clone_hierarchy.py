@@ -1,15 +1,15 @@
-from typing import Any, Callable, Generic, TypeVar
+from typing import IO, Any, Callable, Generic, Iterable, TypeVar
 import logging
+from io import BytesIO
 from dataclasses import dataclass, field
 import re
 from ast import literal_eval
-from copy import deepcopy
 from enum import Enum
 from lxml import etree as ET
 import networkx as nx
 from dearpygui import dearpygui as dpg
 
-from hkb_editor.hkb.xml import xml_from_str, add_type_comments, make_element, make_subelement
+from hkb_editor.hkb.xml import xml_from_str, make_element
 from hkb_editor.hkb.behavior import HavokBehavior, HkbVariable
 from hkb_editor.hkb.hkb_enums import hkbVariableInfo_VariableType as VariableType
 from hkb_editor.hkb.index_attributes import (
@@ -19,6 +19,7 @@ from hkb_editor.hkb.index_attributes import (
 )
 from hkb_editor.hkb import HkbPointer, HkbRecord, HkbArray, XmlValueHandler
 from hkb_editor.hkb.type_registry import TypeMismatch
+from hkb_editor.hkb.record_hash import RecordHasher
 from hkb_editor.gui import style
 from hkb_editor.gui.helpers import common_loading_indicator, add_paragraphs
 
@@ -53,16 +54,44 @@ class MergeResult:
 
 
 def copy_hierarchy(start_obj: HkbRecord) -> str:
-    behavior = start_obj.tagfile
-    start_id = start_obj.object_id
+    buffer = BytesIO()
+    write_hierarchies([(start_obj, buffer)])
+    return buffer.getvalue().decode("utf-8")
+
+
+def write_hierarchies(
+    items: Iterable[tuple[HkbRecord, str | IO[bytes]]],
+) -> None:
+    """Export the hierarchies below one or more objects in the behavior_hierarchy format.
+
+    Each hierarchy is written incrementally to its output, so the exported document is never held in memory as a whole. The objects' xml is written as it is instead of being copied first. When exporting several hierarchies the behavior graph is only explored once.
 
-    hierarchy_graph = behavior.build_graph(start_id)
+    Parameters
+    ----------
+    items : Iterable[tuple[HkbRecord, str  |  IO[bytes]]]
+        Pairs of hierarchy root objects and where to write them to (a file path or binary buffer).
+    """
+    items = list(items)
+    if not items:
+        return
+
+    behavior: HavokBehavior = items[0][0].tagfile
+    graph = behavior.build_graph([obj.object_id for obj, _ in items])
+
+    for start_obj, out in items:
+        _write_hierarchy(behavior, start_obj, graph, out)
+
+
+def _collect_hierarchy(
+    behavior: HavokBehavior, start_obj: HkbRecord, graph: nx.DiGraph
+) -> dict[str, Any]:
+    start_id = start_obj.object_id
 
     root_meta: dict[str, list] = {}
     events: dict[int, str] = {}
     variables: dict[int, HkbVariable] = {}
     animations: dict[int, str] = {}
-    objects: list[HkbRecord] = []
+    objects: dict[str, HkbRecord] = {}
     type_map: dict[str, str] = {}
 
     todo = [start_id]
@@ -70,6 +99,10 @@ def copy_hierarchy(start_obj: HkbRecord) -> str:
     while todo:
         oid = todo.pop()
 
+        # Objects may be referenced by more than one parent
+        if oid in objects:
+            continue
+
         obj = behavior.objects.get(oid)
         if not obj:
             continue
@@ -96,16 +129,17 @@ def copy_hierarchy(start_obj: HkbRecord) -> str:
                     animation_name = behavior.get_animation(anim, None)
                     animations[anim] = animation_name or ""
 
-        objects.append(obj)
+        objects[oid] = obj
         type_map[obj.type_id] = obj.type_name
 
         # Element types need to be remapped, too. Pointers on the other hand are okay since they
         # don't save their subtype in the xml.
-        array: HkbArray
-        for _, array in obj.find_fields_by_class(HkbArray):
-            type_map[array.element_type_id] = array.element_type_name
+        for array in obj.element.iterfind(".//array"):
+            elem_type_id = array.get("elementtypeid")
+            if elem_type_id not in type_map:
+                type_map[elem_type_id] = behavior.type_registry.get_name(elem_type_id)
 
-        todo.extend(hierarchy_graph.successors(oid))
+        todo.extend(graph.successors(oid))
 
     # The root object might need additional data to be merged correctly
     if start_obj.type_name == "hkbStateMachine::StateInfo":
@@ -121,10 +155,9 @@ def copy_hierarchy(start_obj: HkbRecord) -> str:
                 meta_wildcards = root_meta.setdefault("wildcard_transitions", [])
                 meta_wildcards.append(transition)
 
-                # TODO not copied for some reason
                 transition_effect: HkbRecord = transition["transition"].get_target()
-                if transition_effect and transition_effect not in objects:
-                    objects.append(transition_effect)
+                if transition_effect and transition_effect.object_id not in objects:
+                    objects[transition_effect.object_id] = transition_effect
 
                     if transition_effect.type_id not in type_map:
                         type_map[transition_effect.type_id] = (
@@ -137,72 +170,142 @@ def copy_hierarchy(start_obj: HkbRecord) -> str:
 
                 # No break, for the unlikely case that a state has multiple wildcard transitions
 
-    # Create using the parser so we can use our guarded xml element class
-    xml_root = xml_from_str(b"<behavior_hierarchy/>")
-    xml_root_meta = make_subelement(xml_root, "root_meta", root_id=start_id)
-    xml_events = make_subelement(xml_root, "events")
-    xml_variables = make_subelement(xml_root, "variables")
-    xml_animations = make_subelement(xml_root, "animations")
-    xml_types = make_subelement(xml_root, "types")
-    xml_objects = make_subelement(
-        xml_root, "objects", graph=str(nx.to_edgelist(hierarchy_graph))
-    )
-
-    # Root Meta
-    # Unique paths to reach the object, important when importing a subtree
-    for root_path in behavior.get_unique_object_paths(start_id):
-        make_subelement(xml_root_meta, "path").text = str(root_path)
-
-    # Additional metadata for potentially reconstructing the root node
-    for key, items in root_meta.items():
-        meta_group = make_subelement(xml_root_meta, key)
-
-        for item in items:
-            if isinstance(item, XmlValueHandler):
-                meta_group.append(deepcopy(item.element))
-            else:
-                make_subelement(meta_group, "item", value=str(item))
-
-    # Events
-    for idx, evt in events.items():
-        make_subelement(xml_events, "event", idx=str(idx), name=evt)
-
-    # Variables
-    for idx, var in variables.items():
-        # Need to include ALL variable attributes so we can reconsruct it if needed
-        if var:
-            make_subelement(
-                xml_variables,
-                "variable",
-                idx=str(idx),
-                name=var.name,
-                vtype=var.vtype.name,
-                min=str(var.vmin),
-                max=str(var.vmax),
-                default=str(var.default),
-            )
-        else:
-            make_subelement(xml_variables, "variable", idx=str(idx), name="")
+    return {
+        "root_meta": root_meta,
+        "events": events,
+        "variables": variables,
+        "animations": animations,
+        "type_map": type_map,
+        "objects": objects,
+    }
 
-    # Animations
-    for idx, anim in animations.items():
-        make_subelement(xml_animations, "animation", idx=str(idx), name=anim)
 
-    # Types
-    for type_id, type_name in type_map.items():
-        make_subelement(xml_types, "type", id=type_id, name=type_name)
+def _write_hierarchy(
+    behavior: HavokBehavior,
+    start_obj: HkbRecord,
+    graph: nx.DiGraph,
+    out: str | IO[bytes],
+) -> int:
+    start_id = start_obj.object_id
+    hierarchy = _collect_hierarchy(behavior, start_obj, graph)
+    objects: dict[str, HkbRecord] = hierarchy["objects"]
+
+    with ET.xmlfile(out, encoding="utf-8") as xf:
+
+        def write_line(elem: ET._Element) -> None:
+            xf.write("\n")
+            xf.write(elem)
+
+        with xf.element("behavior_hierarchy"):
+            xf.write("\n")
+
+            # Root Meta
+            with xf.element("root_meta", root_id=start_id):
+                # Unique paths to reach the object, important when importing a subtree
+                for root_path in behavior.get_unique_object_paths(start_id):
+                    xf.write("\n")
+                    with xf.element("path"):
+                        xf.write(str(root_path))
+
+                # Additional metadata for potentially reconstructing the root node
+                for key, items in hierarchy["root_meta"].items():
+                    xf.write("\n")
+                    with xf.element(key):
+                        for item in items:
+                            if isinstance(item, XmlValueHandler):
+                                write_line(item.element)
+                            else:
+                                write_line(make_element("item", value=str(item)))
+
+            xf.write("\n")
+
+            # Events
+            with xf.element("events"):
+                for idx, evt in hierarchy["events"].items():
+                    write_line(make_element("event", idx=str(idx), name=evt or ""))
+
+            xf.write("\n")
+
+            # Variables
+            with xf.element("variables"):
+                for idx, var in hierarchy["variables"].items():
+                    # Need to include ALL variable attributes so we can reconsruct it if needed
+                    if var:
+                        write_line(
+                            make_element(
+                                "variable",
+                                idx=str(idx),
+                                name=var.name,
+                                vtype=var.vtype.name,
+                                min=str(var.vmin),
+                                max=str(var.vmax),
+                                default=str(var.default),
+                            )
+                        )
+                    else:
+                        write_line(make_element("variable", idx=str(idx), name=""))
 
-    # Objects
-    for obj in objects:
-        # Be careful not to remove the object elements from their original xml doc!
-        xml_objects.append(deepcopy(obj.as_object()))
+            xf.write("\n")
+
+            # Animations
+            with xf.element("animations"):
+                for idx, anim in hierarchy["animations"].items():
+                    write_line(make_element("animation", idx=str(idx), name=anim))
+
+            xf.write("\n")
+
+            # Types
+            with xf.element("types"):
+                for type_id, type_name in hierarchy["type_map"].items():
+                    write_line(make_element("type", id=type_id, name=type_name))
+
+            xf.write("\n")
+
+            # Graph as adjacency lists
+            with xf.element("graph"):
+                for oid in objects:
+                    # Wildcard transition effects are not part of the explored graph
+                    successors = graph.successors(oid) if oid in graph else []
+                    children = [c for c in successors if c in objects]
+                    if children:
+                        write_line(make_element("node", id=oid, children=" ".join(children)))
+                    else:
+                        write_line(make_element("node", id=oid))
+
+            xf.write("\n")
+
+            # Objects
+            with xf.element("objects"):
+                for obj in objects.values():
+                    xf.write("\n")
+                    # Write the original elements, no need to copy them
+                    with xf.element("object", typeid=obj.type_id, id=obj.object_id):
+                        xf.write(ET.Comment(obj.type_name))
+                        xf.write(obj.element)
+
+            xf.write("\n")
 
-    add_type_comments(xml_root, behavior)
-    ET.indent(xml_root)
-    ret = ET.tostring(xml_root, pretty_print=True, encoding="unicode")
     logging.getLogger().info(f"Serialized {len(objects)} objects")
+    return len(objects)
+
 
-    return ret
+def load_hierarchy_graph(xml: ET._Element) -> nx.DiGraph:
+    graph_elem = xml.find("graph")
+    if graph_elem is not None:
+        graph = nx.DiGraph()
+        for node in graph_elem.iterfind("node"):
+            oid = node.get("id")
+            graph.add_node(oid)
+            graph.add_edges_from((oid, child) for child in node.get("children", "").split())
+
+        return graph
+
+    # Hierarchies exported by older versions store a stringified edge list
+    graph_data = xml.find("objects").get("graph")
+    if graph_data:
+        return nx.from_edgelist(literal_eval(graph_data), nx.DiGraph)
+
+    return None
 
 
 def import_hierarchy(
@@ -236,7 +339,10 @@ def import_hierarchy(
 
     def update_target_pointers(results: MergeResult):
         hierarchy_root = results.objects[results.root_id]
-        if not hierarchy_root.result or hierarchy_root.action != MergeAction.NEW:
+        if not hierarchy_root.result or hierarchy_root.action not in (
+            MergeAction.NEW,
+            MergeAction.REUSE,
+        ):
             return
 
         target_id = hierarchy_root.result.object_id
@@ -422,18 +528,23 @@ def paste_children(
 
         for res in results.objects.values():
             obj: HkbRecord = res.result
-            if obj and res.action == MergeAction.NEW:
-                if obj.object_id in root_children:
-                    if refptr.will_accept(obj):
+            if not obj or res.action not in (MergeAction.NEW, MergeAction.REUSE):
+                continue
+
+            # The root's pointers have been remapped already, so reused children are
+            # found by their existing ID
+            if obj.object_id in root_children:
+                if refptr.will_accept(obj):
+                    if res.action == MergeAction.NEW:
                         behavior.add_object(obj)
-                        target_array.append(obj.object_id)
-                    else:
-                        res.action = MergeAction.SKIP
-                        logger.warning(
-                            f"Skipping incompatible hierarchy child {str(obj)}"
-                        )
+                    target_array.append(obj.object_id)
                 else:
-                    behavior.add_object(obj)
+                    res.action = MergeAction.SKIP
+                    logger.warning(
+                        f"Skipping incompatible hierarchy child {str(obj)}"
+                    )
+            elif res.action == MergeAction.NEW:
+                behavior.add_object(obj)
 
         # If we copy only the root's children we should merge the relevant wildcard transitions
         if source_obj.type_name == "hkbStateMachine":
@@ -490,13 +601,25 @@ def find_conflicts(
         # If there is no match it probably has to be created. If it exists but the index is different
         # we still treat it as a conflict, albeit one that has a likely solution.
 
+        # Name lookups are done through hash maps so that the cost stays linear in the
+        # size of the hierarchy and the behavior. Like find_*, the first entry wins.
+        def index_map(names: Iterable[str]) -> dict[str, int]:
+            lookup = {}
+            for idx, name in enumerate(names):
+                lookup.setdefault(name, idx)
+            return lookup
+
+        event_lookup = index_map(behavior.get_events())
+        variable_lookup = index_map(behavior.get_variables())
+        animation_lookup = index_map(behavior.get_animations(full_names=True))
+
         # Events
         for evt in xml.findall(".//event"):
             idx = int(evt.get("idx"))
             name = evt.get("name")
 
             if name:
-                match_idx = behavior.find_event(name, -1)
+                match_idx = event_lookup.get(name, -1)
                 action = MergeAction.NEW if match_idx < 0 else MergeAction.REUSE
                 results.events[idx] = Resolution((idx, name), action, (match_idx, name))
             else:
@@ -522,7 +645,7 @@ def find_conflicts(
                     pass
 
                 var = HkbVariable(name, vtype, vmin, vmax, default)
-                match_idx = behavior.find_variable(name, -1)
+                match_idx = variable_lookup.get(name, -1)
 
                 if match_idx < 0:
                     results.variables[idx] = Resolution(
@@ -543,7 +666,9 @@ def find_conflicts(
             name = anim.get("name")
 
             if name:
-                match_idx = behavior.find_animation(name, -1)
+                match_idx = animation_lookup.get(
+                    behavior.get_full_animation_name(name), -1
+                )
                 action = MergeAction.NEW if match_idx < 0 else MergeAction.REUSE
                 results.animations[idx] = Resolution(
                     (idx, name), action, (match_idx, name)
@@ -581,6 +706,26 @@ def find_conflicts(
         logger = logging.getLogger()
         mismatching_types = set()
 
+        # Shared objects like transition effects are reused if the behavior already has
+        # an object with identical content. Matching is done by joining the content hashes
+        # of both sides. The hierarchy's hashes must be calculated before the type IDs
+        # below are remapped.
+        reusable_types = ("CustomTransitionEffect", "hkbBlendingTransitionEffect")
+        hierarchy_hasher = RecordHasher.from_hierarchy(xml)
+        hierarchy_hashes = {
+            xmlobj.get("id"): hierarchy_hasher.get_hash(xmlobj.get("id"))
+            for xmlobj in xml.iterfind("objects/object")
+            if results.type_map[xmlobj.get("typeid")].result[1] in reusable_types
+        }
+
+        behavior_hasher = RecordHasher.from_tagfile(behavior)
+        behavior_hashes: dict[bytes, HkbRecord] = {}
+        if hierarchy_hashes:
+            for candidate in behavior.objects.values():
+                if candidate.type_name in reusable_types:
+                    digest = behavior_hasher.get_hash(candidate.object_id)
+                    behavior_hashes.setdefault(digest, candidate)
+
         for xmlobj in xml.find("objects").getchildren():
             # Remap the typeid. Should only be relevant when cloning between different games or
             # versions of hklib, but in those cases it might just make it work
@@ -630,17 +775,20 @@ def find_conflicts(
                     f"Failed to reconstruct object {xmlobj.get('id')} from xml"
                 ) from e
 
-            # Pointers
-            # Find pointers in the behavior referencing this object's ID. If more than one
-            # other object is already referencing it, it is most likely a reused object like
-            # e.g. DefaultTransition.
-            existing_obj = behavior.objects.get(obj.object_id)
-            if (
-                existing_obj
-                and existing_obj.type_name == obj.type_name
-                and obj.type_name
-                in ("CustomTransitionEffect", "hkbBlendingTransitionEffect")
-            ):
+            # Reuse shared objects if an identical one already exists. Prefer the object
+            # with the same ID, e.g. when pasting back into the original behavior.
+            digest = hierarchy_hashes.get(obj.object_id)
+            existing_obj = None
+            if digest is not None:
+                existing_obj = behavior.objects.get(obj.object_id)
+                if (
+                    not existing_obj
+                    or existing_obj.type_name != obj.type_name
+                    or behavior_hasher.get_hash(existing_obj.object_id) != digest
+                ):
+                    existing_obj = behavior_hashes.get(digest)
+
+            if existing_obj:
                 results.objects[obj.object_id] = Resolution(
                     obj, MergeAction.REUSE, existing_obj
                 )
@@ -662,24 +810,31 @@ def resolve_conflicts(
     # TODO this should be optional
     # TODO define various conflict resolution strategies, like skip on conflict, reuse
     # on conflict, and whether to continue following a path if the parent had a conflict
+    root_id = next(iter(results.objects), None)
+
+    # Collect the parents of each object once instead of searching all objects every time
+    referrers: dict[str, list[Resolution[HkbRecord]]] = {}
+    for other in results.objects.values():
+        if not other.original:
+            continue
+
+        ptr: HkbPointer
+        for _, ptr in other.original.find_fields_by_class(HkbPointer):
+            target_id = ptr.get_value()
+            if target_id and target_id != other.original.object_id:
+                referrers.setdefault(target_id, []).append(other)
+
     def is_object_included(object_id: str) -> bool:
         # The root object will not have any parents to check
-        if object_id == list(results.objects.keys())[0]:
+        if object_id == root_id:
             return True
 
         # Check parents: if all of them are skipped or reused,
         # this one should be skipped, too
-        for other in results.objects.values():
-            if not other.result or other.result.object_id == object_id:
-                continue
-
-            if other.action in (MergeAction.NEW, MergeAction.IGNORE):
-                ptr: HkbPointer
-                for _, ptr in other.result.find_fields_by_class(HkbPointer):
-                    if ptr.get_value() == object_id:
-                        return True
-
-        return False
+        return any(
+            other.action in (MergeAction.NEW, MergeAction.IGNORE)
+            for other in referrers.get(object_id, ())
+        )
 
     # Create missing events, variables and animations. If the value is not MergeAction.NEW we can
     # expect that a mapping to another value has been applied
@@ -753,7 +908,9 @@ def resolve_conflicts(
                 resolution.result.object_id = new_id
 
         elif resolution.action == MergeAction.REUSE:
-            resolution.result = behavior.objects[object_id]
+            # find_conflicts may have matched an identical object with a different ID
+            if resolution.result is resolution.original:
+                resolution.result = behavior.objects[object_id]
         elif resolution.action == MergeAction.IGNORE:
             # Will not be added, but giving it a new ID will prevent other objects from
             # accidently referring to existing objects from the behavior
@@ -829,6 +986,55 @@ def resolve_conflicts(
     # Handle additional root metadata
     restore_root_meta(behavior, target_record, results)
 
+    verify_object_references(behavior, results)
+
+
+def verify_object_references(behavior: HavokBehavior, results: MergeResult) -> int:
+    """Check that the objects about to be added only point to objects that will exist after merging. In particular, pointers must not use the hierarchy's ID of an object that was resolved to an existing object with a different ID.
+
+    Parameters
+    ----------
+    behavior : HavokBehavior
+        The behavior the hierarchy is merged into.
+    results : MergeResult
+        Conflicts after they have been resolved by [resolve_conflicts][].
+
+    Returns
+    -------
+    int
+        The number of invalid pointers found. Each one is logged as an error.
+    """
+    logger = logging.getLogger()
+
+    valid_ids = set()
+    replaced_ids = set()
+    for object_id, res in results.objects.items():
+        if not res.result or res.action not in (MergeAction.NEW, MergeAction.REUSE):
+            continue
+
+        valid_ids.add(res.result.object_id)
+        if res.result.object_id != object_id:
+            replaced_ids.add(object_id)
+
+    invalid = 0
+    for object_id, res in results.objects.items():
+        if not res.result or res.action != MergeAction.NEW:
+            continue
+
+        ptr: HkbPointer
+        for path, ptr in res.result.find_fields_by_class(HkbPointer):
+            target_id = ptr.get_value()
+            if not target_id or target_id in valid_ids:
+                continue
+
+            if target_id in replaced_ids or target_id not in behavior.objects:
+                logger.error(
+                    f"Object {object_id} ({res.result.object_id}) still points to {target_id} at {path}, which was not remapped"
+                )
+                invalid += 1
+
+    return invalid
+
 
 def restore_root_meta(
     behavior: HavokBehavior,
@@ -906,10 +1112,10 @@ def restore_root_meta(
                     if condition_res.action in (MergeAction.NEW, MergeAction.REUSE):
                         # Update referenced transition condition
                         new_condition = condition_res.result.object_id
-                        transition["transition"].set_value(new_condition)
+                        transition["condition"].set_value(new_condition)
                     elif condition_res.action in (MergeAction.IGNORE, MergeAction.SKIP):
                         # Unset the transition condition
-                        transition["transition"].set_value(None)
+                        transition["condition"].set_value(None)
 
             wildcards.append(transition)
 
@@ -1016,7 +1222,7 @@ def open_merge_hierarchy_dialog(
     if tag in (0, None, ""):
         tag = f"merge_hierarchy_dialog_{dpg.generate_uuid()}"
 
-    graph_data = xml.find("objects").get("graph")
+    graph = load_hierarchy_graph(xml)
     graph_preview = None
 
     def update_action(sender: str, action: str, resolution: Resolution):
@@ -1046,7 +1252,7 @@ def open_merge_hierarchy_dialog(
 
     # Window content
     with dpg.window(
-        width=1100 if graph_data else 600,
+        width=1100 if graph else 600,
         height=690,
         label="Merge Hierarchy",
         modal=False,
@@ -1055,10 +1261,9 @@ def open_merge_hierarchy_dialog(
         tag=tag,
     ) as dialog:
         with dpg.group(horizontal=True):
-            if graph_data:
+            if graph:
                 from hkb_editor.gui.widgets import GraphWidget
 
-                graph = nx.from_edgelist(literal_eval(graph_data), nx.DiGraph)
                 highlighted_rows: dict[str, list[int]] = {}
                 highlight_color = list(style.yellow)
 
@@ -1360,7 +1565,10 @@ def open_merge_hierarchy_dialog(
                                     dpg.add_text(name)
 
                                     actions = [a.name for a in MergeAction]
-                                    if oid not in behavior.objects:
+                                    if (
+                                        oid not in behavior.objects
+                                        and resolution.action != MergeAction.REUSE
+                                    ):
                                         # Can't reuse if there is no match
                                         actions.remove(MergeAction.REUSE.name)
 
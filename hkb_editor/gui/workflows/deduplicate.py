@@ -0,0 +1,301 @@
+from typing import Any, Callable
+import logging
+from dataclasses import dataclass, field
+from lxml import etree as ET
+import networkx as nx
+from dearpygui import dearpygui as dpg
+
+from hkb_editor.hkb import HavokBehavior, HkbRecord, HkbPointer
+from hkb_editor.hkb.record_hash import RecordHasher
+from hkb_editor.gui.helpers import (
+    center_window,
+    add_paragraphs,
+    common_loading_indicator,
+)
+from hkb_editor.gui import style
+
+
+# Objects whose identity matters, either because the game or other objects refer to
+# them as individuals, or because they are unique anyways
+default_excluded_types = (
+    "hkbStateMachine",
+    "hkbStateMachine::StateInfo",
+    "hkRootLevelContainer",
+    "hkbBehaviorGraph",
+    "hkbBehaviorGraphData",
+    "hkbBehaviorGraphStringData",
+    "hkbVariableValueSet",
+)
+
+
+@dataclass
+class DuplicateGroup:
+    canonical: HkbRecord
+    duplicates: list[HkbRecord] = field(default_factory=list)
+    saved_bytes: int = 0
+
+
+def find_duplicates(
+    behavior: HavokBehavior,
+    excluded_types: tuple[str, ...] = default_excluded_types,
+) -> list[DuplicateGroup]:
+    """Find groups of objects with identical content, including the hierarchies they reference.
+
+    Objects of excluded types are never considered. The same is true for objects which reference an excluded object (directly or indirectly) or are part of a reference cycle, as merging them would leave behind orphaned objects that cannot be merged.
+
+    Parameters
+    ----------
+    behavior : HavokBehavior
+        The behavior to search.
+    excluded_types : tuple[str, ...], optional
+        Type names of objects that must not be merged.
+
+    Returns
+    -------
+    list[DuplicateGroup]
+        Groups of identical objects. The canonical object of each group is the first one in document order.
+    """
+    graph = nx.DiGraph()
+    blocked = set()
+
+    for obj in behavior.objects.values():
+        graph.add_node(obj.object_id)
+        if obj.type_name in excluded_types:
+            blocked.add(obj.object_id)
+
+        ptr: HkbPointer
+        for _, ptr in obj.find_fields_by_class(HkbPointer):
+            target_id = ptr.get_value()
+            if target_id:
+                graph.add_edge(obj.object_id, target_id)
+
+    for component in nx.strongly_connected_components(graph):
+        if len(component) > 1:
+            blocked.update(component)
+
+    # Anything referencing a blocked object is blocked, too
+    todo = [oid for oid in blocked if oid in graph]
+    while todo:
+        oid = todo.pop()
+        for parent_id in graph.predecessors(oid):
+            if parent_id not in blocked:
+                blocked.add(parent_id)
+                todo.append(parent_id)
+
+    hasher = RecordHasher.from_tagfile(behavior)
+    groups: dict[bytes, DuplicateGroup] = {}
+
+    for obj in behavior.objects.values():
+        if obj.object_id in blocked:
+            continue
+
+        digest = hasher.get_hash(obj.object_id)
+        group = groups.get(digest)
+
+        if group is None:
+            groups[digest] = DuplicateGroup(obj)
+        else:
+            group.duplicates.append(obj)
+            group.saved_bytes += len(ET.tostring(obj.element.getparent()))
+
+    return [g for g in groups.values() if g.duplicates]
+
+
+def merge_duplicates(behavior: HavokBehavior, groups: list[DuplicateGroup]) -> int:
+    """Repoint all references to duplicates to their canonical object and delete the duplicates. This is done in a single transaction.
+
+    Objects which were only referenced by deleted duplicates are deleted as well. This happens when a group is merged but the groups of its children are not.
+
+    Parameters
+    ----------
+    behavior : HavokBehavior
+        The behavior the groups were found in.
+    groups : list[DuplicateGroup]
+        The groups to merge, see `find_duplicates`.
+
+    Returns
+    -------
+    int
+        Number of deleted objects.
+    """
+    canonical_ids = {
+        dup.object_id: group.canonical.object_id
+        for group in groups
+        for dup in group.duplicates
+    }
+
+    if not canonical_ids:
+        return 0
+
+    children: dict[str, set[str]] = {}
+    referrers: dict[str, set[str]] = {}
+
+    with behavior.transaction():
+        for obj in behavior.objects.values():
+            targets = children.setdefault(obj.object_id, set())
+
+            ptr: HkbPointer
+            for _, ptr in obj.find_fields_by_class(HkbPointer):
+                target_id = ptr.get_value()
+                new_id = canonical_ids.get(target_id)
+                if new_id:
+                    ptr.set_value(new_id)
+                    target_id = new_id
+
+                if target_id:
+                    targets.add(target_id)
+                    referrers.setdefault(target_id, set()).add(obj.object_id)
+
+        # Children of the deleted duplicates that are not referenced anywhere else
+        # would be left behind as orphans
+        removed = set(canonical_ids.keys())
+        todo = list(removed)
+        while todo:
+            oid = todo.pop()
+            for child_id in children.get(oid, ()):
+                if child_id in removed or child_id not in behavior.objects:
+                    continue
+
+                if referrers[child_id].issubset(removed):
+                    removed.add(child_id)
+                    todo.append(child_id)
+
+        for oid in removed:
+            behavior.delete_object(oid)
+
+    return len(removed)
+
+
+def deduplicate_dialog(
+    behavior: HavokBehavior,
+    callback: Callable[[str, int, Any], None] = None,
+    *,
+    tag: str = 0,
+    user_data: Any = None,
+) -> None:
+    if tag in (0, "", None):
+        tag = f"deduplicate_{dpg.generate_uuid()}"
+
+    logger = logging.getLogger("deduplicate")
+    groups_by_type: dict[str, list[DuplicateGroup]] = {}
+
+    def analyze() -> None:
+        groups_by_type.clear()
+
+        loading = common_loading_indicator("Analyzing")
+        try:
+            for group in find_duplicates(behavior):
+                groups_by_type.setdefault(group.canonical.type_name, []).append(group)
+        finally:
+            dpg.delete_item(loading)
+
+        dpg.delete_item(f"{tag}_table", children_only=True, slot=1)
+
+        total_objects = 0
+        total_bytes = 0
+
+        for type_name, groups in sorted(groups_by_type.items()):
+            num_dups = sum(len(g.duplicates) for g in groups)
+            num_bytes = sum(g.saved_bytes for g in groups)
+            total_objects += num_dups
+            total_bytes += num_bytes
+
+            with dpg.table_row(parent=f"{tag}_table"):
+                dpg.add_checkbox(default_value=True, tag=f"{tag}_merge_{type_name}")
+                dpg.add_text(type_name)
+                dpg.add_text(str(len(groups)))
+                dpg.add_text(str(num_dups))
+                dpg.add_text(f"{num_bytes / 1024:.1f} KiB")
+
+        summary = f"{total_objects} duplicate objects, {total_bytes / 1024:.1f} KiB"
+        logger.info(f"Found {summary}")
+        dpg.set_value(f"{tag}_summary", summary)
+
+    def show_message(msg: str = None, color: style.RGBA = style.red) -> None:
+        if msg:
+            dpg.configure_item(
+                f"{tag}_notification",
+                default_value=msg,
+                color=color,
+                show=True,
+            )
+        else:
+            dpg.hide_item(f"{tag}_notification")
+
+    def on_okay():
+        show_message()
+
+        selected = [
+            group
+            for type_name, groups in groups_by_type.items()
+            if dpg.get_value(f"{tag}_merge_{type_name}")
+            for group in groups
+        ]
+
+        loading = common_loading_indicator("Merging")
+        try:
+            removed = merge_duplicates(behavior, selected)
+        except Exception:
+            show_message("Error merging duplicates, check terminal!")
+            raise
+        finally:
+            dpg.delete_item(loading)
+
+        logger.info(f"Removed {removed} duplicate and orphaned objects")
+        analyze()
+        show_message(
+            f"Removed {removed} duplicate and orphaned objects", color=style.blue
+        )
+
+        if callback:
+            callback(tag, removed, user_data)
+
+    # Dialog content
+    with dpg.window(
+        label="Deduplicate Objects",
+        width=500,
+        height=400,
+        autosize=True,
+        on_close=lambda: dpg.delete_item(dialog),
+        no_saved_settings=True,
+        tag=tag,
+    ) as dialog:
+        with dpg.table(
+            header_row=True,
+            policy=dpg.mvTable_SizingFixedFit,
+            borders_innerH=True,
+            scrollY=True,
+            height=300,
+            tag=f"{tag}_table",
+        ):
+            dpg.add_table_column(label="merge", width_fixed=True)
+            dpg.add_table_column(label="type", width_stretch=True)
+            dpg.add_table_column(label="groups", width_fixed=True)
+            dpg.add_table_column(label="duplicates", width_fixed=True)
+            dpg.add_table_column(label="savings", width_fixed=True)
+
+        dpg.add_text(tag=f"{tag}_summary")
+
+        instructions = """\
+Objects with identical content (including the objects they reference) will be merged into one instance that all references will point to. StateInfos and statemachines are never merged.
+"""
+        add_paragraphs(instructions, 50, color=style.light_blue)
+
+        # Main form done, now just some buttons and such
+        dpg.add_separator()
+
+        dpg.add_text(show=False, tag=f"{tag}_notification", color=style.red)
+
+        with dpg.group(horizontal=True):
+            dpg.add_button(label="Merge", callback=on_okay, tag=f"{tag}_button_okay")
+            dpg.add_button(
+                label="Cancel",
+                callback=lambda: dpg.delete_item(dialog),
+            )
+
+    analyze()
+
+    dpg.split_frame()
+    center_window(dialog)
+
+    return dialog
@@ -2,8 +2,8 @@ from typing import Any, Callable
 import logging
 from dearpygui import dearpygui as dpg
 
-from hkb_editor.hkb import HavokBehavior, HkbArray, HkbPointer
-from hkb_editor.templates.common import Animation
+from hkb_editor.hkb import HavokBehavior
+from hkb_editor.hkb.fixes import fix_common_problems, common_fixes
 from hkb_editor.gui.helpers import (
     center_window,
     add_paragraphs,
@@ -24,85 +24,6 @@ def fix_common_problems_dialog(
 
     logger = logging.getLogger("fix_common_problems")
 
-    def fix_array_null_pointers() -> int:
-        issues = 0
-        for record in behavior:
-            array: HkbArray
-            for path, array in record.find_fields_by_class(HkbArray):
-                # Some pointer arrays in the root objects must not be altered, so we limit
-                # it to generators for now where we know how they work
-                if not path.endswith("generators"):
-                    continue
-
-                if array.is_pointer_array:
-                    invalid = []
-                    for idx, ptr in enumerate(array):
-                        if not ptr.is_set():
-                            invalid.append(idx)
-
-                    for idx in reversed(invalid):
-                        array.pop(idx)
-
-                    issues += len(invalid)
-
-        logger.info(f"Removed {issues} stray null pointers from arrays")
-        return issues
-
-    def fix_clip_animation_ids() -> int:
-        issues = 0
-        new_anims = 0
-        for record in behavior:
-            if record.type_name == "hkbClipGenerator":
-                anim_name = record["animationName"].get_value()
-                if not Animation.is_valid_name(anim_name):
-                    logger.warning(f"{record} has invalid animationName {anim_name}")
-                    continue
-
-                anim_id = record["animationInternalId"].get_value()
-                true_anim_id = behavior.find_animation(anim_name, None)
-
-                if anim_id != true_anim_id:
-                    if true_anim_id is None:
-                        true_anim_id = behavior.create_animation(anim_name)
-                        new_anims += 1
-
-                    record["animationInternalId"] = true_anim_id
-                    issues += 1
-
-        logger.info(f"Added {new_anims} missing animation IDs")
-        logger.info(f"Fixed {issues} clip generators")
-        return issues
-
-    def clear_invalid_pointers() -> int:
-        invalid = 0
-
-        for record in behavior.objects.values():
-            ptr: HkbPointer
-            for _, ptr in record.find_fields_by_class(HkbPointer):
-                oid = ptr.get_value()
-                if oid:
-                    try:
-                        behavior.objects[oid]
-                    except KeyError:
-                        ptr.set_value(None)
-                        invalid += 1
-
-        logger.info(f"Unset {invalid} invalid pointers")
-        return invalid
-
-    def remove_orphans() -> int:
-        root = behavior.behavior_root
-        g = behavior.build_graph(root.object_id)
-
-        unmapped_ids = set(behavior.objects.keys()).difference(g.nodes)
-        orphans = [behavior.objects[oid] for oid in unmapped_ids]
-
-        for obj in orphans:
-            behavior.delete_object(obj)
-
-        logger.info(f"Removed {len(orphans)} abandoned objects")
-        return len(orphans)
-
     def show_message(msg: str = None, color: style.RGBA = style.red) -> None:
         if msg:
             dpg.configure_item(
@@ -119,19 +40,10 @@ def fix_common_problems_dialog(
         loading = common_loading_indicator("Fixing")
 
         try:
-            with behavior.transaction():
-                fixes = 0
-                if dpg.get_value(f"{tag}_array_null_pointers"):
-                    fixes += fix_array_null_pointers()
-
-                if dpg.get_value(f"{tag}_clip_animation_ids"):
-                    fixes += fix_clip_animation_ids()
-
-                if dpg.get_value(f"{tag}_clear_invalid_pointers"):
-                    fixes += clear_invalid_pointers()
-
-                if dpg.get_value(f"{tag}_remove_orphans"):
-                    fixes += remove_orphans()
+            selected = [
+                name for name in common_fixes if dpg.get_value(f"{tag}_{name}")
+            ]
+            fixes = sum(fix_common_problems(behavior, selected, logger).values())
 
             logger.info(f"Fixed {fixes} issues")
             show_message(f"Fixed {fixes} issues", color=style.blue)
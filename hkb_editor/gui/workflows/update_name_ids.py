@@ -5,23 +5,12 @@ from pathlib import Path
 from dearpygui import dearpygui as dpg
 
 from hkb_editor.hkb import HavokBehavior
+from hkb_editor.hkb.verify import get_nameidfile_folder
 from hkb_editor.gui.dialogs import open_file_dialog
 from hkb_editor.gui.helpers import add_paragraphs, center_window
 from hkb_editor.gui import style
 
 
-def get_nameidfile_folder(behavior: HavokBehavior) -> Path:
-    # Default paths
-    # Behaviors will usually be located in
-    # mod/chr/cXXXX-behbnd-dcx/Behavior/cXXXX.xml
-    # and we are looking for the name ID files in
-    # mod/action/
-    try:
-        return Path(behavior.file).parents[3] / "action"
-    except IndexError:
-        return None
-
-
 def update_name_ids_dialog(
     behavior: HavokBehavior,
     *,
@@ -1,4 +1,4 @@
-from typing import Any, Iterable
+from typing import Any, Callable, Iterable
 from dataclasses import dataclass
 import re
 import logging
@@ -28,13 +28,21 @@ class HkbVariable:
 
 
 class HavokBehavior(Tagfile):
-    def __init__(self, xml_file: str, undo: bool):
+    def __init__(
+        self,
+        xml_file: str,
+        undo: bool,
+        progress: Callable[[str], None] = None,
+    ):
         # Define before _regenerate_cache runs the first time
         self._events: CachedArray[str] = None
         self._variables: CachedArray[str] = None
         self._animations: CachedArray[str] = None
 
-        super().__init__(xml_file, undo)
+        super().__init__(xml_file, undo, progress=progress)
+
+        if progress:
+            progress("graph")
 
         # Locate the root statemachine
         self.root_sm = None
@@ -60,6 +68,7 @@ class HavokBehavior(Tagfile):
 
     def _regenerate_cache(self):
         super()._regenerate_cache()
+        self._report_progress("name arrays")
 
         # There's some special objects storing the string values referenced from HKS
         strings_type_id = self.type_registry.find_first_type_by_name(
@@ -543,8 +552,8 @@ class HavokBehavior(Tagfile):
             used_indices.sort()
 
             # Remove any items that are no longer referenced
-            for idx in reversed(used_indices):
-                del defaults[idx]
+            used = set(used_indices)
+            defaults.delete_indices(i for i in range(len(defaults)) if i not in used)
 
             # Update the references to the new indices
             old_to_new = {old: new for new, old in enumerate(used_indices)}
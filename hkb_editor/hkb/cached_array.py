@@ -1,4 +1,5 @@
-from typing import Generic, TypeVar, Generator
+from typing import Any, Generic, TypeVar, Generator, Iterable
+import sys
 
 from .hkb_types import XmlValueHandler, HkbArray
 
@@ -6,6 +7,17 @@ from .hkb_types import XmlValueHandler, HkbArray
 T = TypeVar("T")
 
 
+def _cached_value(value: XmlValueHandler | Any) -> Any:
+    if isinstance(value, XmlValueHandler):
+        value = value.get_value()
+
+    # Names are often shared between behaviors (e.g. events and animations)
+    if type(value) is str:
+        return sys.intern(value)
+
+    return value
+
+
 class CachedArray(Generic[T]):
     def __init__(self, array: HkbArray):
         super().__init__()
@@ -14,7 +26,7 @@ class CachedArray(Generic[T]):
         self._rebuild_cache()
 
     def _rebuild_cache(self) -> None:
-        self._cache = [x.get_value() for x in self.array]
+        self._cache = [_cached_value(x) for x in self.array]
 
     def clear(self) -> None:
         self.array.clear()
@@ -40,7 +52,7 @@ class CachedArray(Generic[T]):
 
     def __setitem__(self, index: int, value: XmlValueHandler | T) -> None:
         self.array[index].set_value(value)
-        val = value.get_value() if isinstance(value, XmlValueHandler) else value
+        val = _cached_value(value)
         self._cache[index] = val
 
     def __delitem__(self, index: int) -> None:
@@ -60,14 +72,42 @@ class CachedArray(Generic[T]):
 
     def append(self, value: XmlValueHandler | T) -> None:
         self.array.append(value)
-        val = value.get_value() if isinstance(value, XmlValueHandler) else value
+        val = _cached_value(value)
         self._cache.append(val)
 
     def insert(self, index: int, value: XmlValueHandler | T) -> None:
         self.array.insert(index, value)
-        val = value.get_value() if isinstance(value, XmlValueHandler) else value
+        val = _cached_value(value)
         self._cache.insert(index, val)
 
     def pop(self, index: int) -> T:
         del self.array[index]
         return self._cache.pop(index)
+
+    def extend(self, values: list[XmlValueHandler | T]) -> None:
+        values = list(values)
+        self.array.extend(values)
+        self._cache.extend(_cached_value(v) for v in values)
+
+    def delete_indices(self, indices: Iterable[int]) -> list[T]:
+        size = len(self._cache)
+        drop = {size + i if i < 0 else i for i in indices}
+        self.array.delete_indices(drop)
+
+        removed = [self._cache[i] for i in sorted(drop)]
+        self._cache = [v for i, v in enumerate(self._cache) if i not in drop]
+        return removed
+
+    def permute(self, order: list[int]) -> None:
+        self.array.permute(order)
+        self._cache = [self._cache[i] for i in order]
+
+    def replace_slice(
+        self, start: int, stop: int, values: list[XmlValueHandler | T]
+    ) -> None:
+        values = list(values)
+        start, stop, _ = slice(start, stop).indices(len(self._cache))
+        stop = max(start, stop)
+
+        self.array.replace_slice(start, stop, values)
+        self._cache[start:stop] = [_cached_value(v) for v in values]
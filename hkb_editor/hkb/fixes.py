@@ -0,0 +1,143 @@
+from typing import Callable, Iterable
+import logging
+import re
+
+from .behavior import HavokBehavior
+from .hkb_types import HkbArray, HkbPointer
+
+
+def fix_array_null_pointers(behavior: HavokBehavior, logger: logging.Logger) -> int:
+    issues = 0
+    for record in behavior:
+        array: HkbArray
+        for path, array in record.find_fields_by_class(HkbArray):
+            # Some pointer arrays in the root objects must not be altered, so we limit
+            # it to generators for now where we know how they work
+            if not path.endswith("generators"):
+                continue
+
+            if array.is_pointer_array:
+                invalid = []
+                for idx, ptr in enumerate(array):
+                    if not ptr.is_set():
+                        invalid.append(idx)
+
+                array.delete_indices(invalid)
+
+                issues += len(invalid)
+
+    logger.info(f"Removed {issues} stray null pointers from arrays")
+    return issues
+
+
+def fix_clip_animation_ids(behavior: HavokBehavior, logger: logging.Logger) -> int:
+    issues = 0
+    new_anims = 0
+    for record in behavior:
+        if record.type_name == "hkbClipGenerator":
+            anim_name = record["animationName"].get_value()
+            if not re.match(r"a[0-9]{3}_[0-9]{6}", anim_name):
+                logger.warning(f"{record} has invalid animationName {anim_name}")
+                continue
+
+            anim_id = record["animationInternalId"].get_value()
+            true_anim_id = behavior.find_animation(anim_name, None)
+
+            if anim_id != true_anim_id:
+                if true_anim_id is None:
+                    true_anim_id = behavior.create_animation(anim_name)
+                    new_anims += 1
+
+                record["animationInternalId"] = true_anim_id
+                issues += 1
+
+    logger.info(f"Added {new_anims} missing animation IDs")
+    logger.info(f"Fixed {issues} clip generators")
+    return issues
+
+
+def clear_invalid_pointers(behavior: HavokBehavior, logger: logging.Logger) -> int:
+    invalid = 0
+
+    for record in behavior.objects.values():
+        ptr: HkbPointer
+        for _, ptr in record.find_fields_by_class(HkbPointer):
+            oid = ptr.get_value()
+            if oid:
+                try:
+                    behavior.objects[oid]
+                except KeyError:
+                    ptr.set_value(None)
+                    invalid += 1
+
+    logger.info(f"Unset {invalid} invalid pointers")
+    return invalid
+
+
+def remove_orphans(behavior: HavokBehavior, logger: logging.Logger) -> int:
+    root = behavior.behavior_root
+    g = behavior.build_graph(root.object_id)
+
+    unmapped_ids = set(behavior.objects.keys()).difference(g.nodes)
+    orphans = [behavior.objects[oid] for oid in unmapped_ids]
+
+    for obj in orphans:
+        behavior.delete_object(obj)
+
+    logger.info(f"Removed {len(orphans)} abandoned objects")
+    return len(orphans)
+
+
+# Fixes by name, in the order they should be applied
+common_fixes: dict[str, Callable[[HavokBehavior, logging.Logger], int]] = {
+    "array_null_pointers": fix_array_null_pointers,
+    "clip_animation_ids": fix_clip_animation_ids,
+    "clear_invalid_pointers": clear_invalid_pointers,
+    "remove_orphans": remove_orphans,
+}
+
+# Removing orphans may delete objects that are still needed later
+default_fixes = ("array_null_pointers", "clip_animation_ids", "clear_invalid_pointers")
+
+
+def fix_common_problems(
+    behavior: HavokBehavior,
+    fixes: Iterable[str] = default_fixes,
+    logger: logging.Logger = None,
+) -> dict[str, int]:
+    """Apply automatic fixes for common problems in a single transaction. Note that most severe issues cannot be fixed automatically, see [verify_behavior][].
+
+    Parameters
+    ----------
+    behavior : HavokBehavior
+        The behavior to fix. Must have undo enabled.
+    fixes : Iterable[str], optional
+        Names of the fixes to apply, see `common_fixes`. They will always run in the order they are defined in.
+    logger : logging.Logger, optional
+        The logger to report details to.
+
+    Returns
+    -------
+    dict[str, int]
+        The number of issues fixed by each fix.
+
+    Raises
+    ------
+    KeyError
+        If an unknown fix was requested.
+    """
+    if logger is None:
+        logger = logging.getLogger("fix_common_problems")
+
+    fixes = set(fixes)
+    unknown = fixes.difference(common_fixes)
+    if unknown:
+        raise KeyError(f"Unknown fixes: {sorted(unknown)}")
+
+    results = {}
+    with behavior.transaction():
+        for name, fix in common_fixes.items():
+            if name in fixes:
+                results[name] = fix(behavior, logger)
+
+    return results
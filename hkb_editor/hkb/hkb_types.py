@@ -1,5 +1,6 @@
-from typing import Any, Type, Generator, Iterator, Mapping, Generic, TypeVar
+from typing import Any, Type, Generator, Iterable, Iterator, Mapping, Generic, TypeVar
 import struct
+import sys
 from lxml import etree as ET
 
 from .tagfile import Tagfile
@@ -12,6 +13,10 @@ _undefined = object()
 
 
 class XmlValueHandler:
+    # Handlers are created on every field access and a record is kept for every
+    # object, so avoid the overhead of a __dict__
+    __slots__ = ("tagfile", "element", "type_id")
+
     @classmethod
     def new(
         cls, tagfile: Tagfile, type_id: str, value: Any = None
@@ -54,6 +59,8 @@ T = TypeVar("T", bound=XmlValueHandler)
 
 
 class HkbString(XmlValueHandler):
+    __slots__ = ()
+
     @classmethod
     def new(cls, tagfile: Tagfile, type_id: str, value: str = None) -> "HkbString":
         val = str(value) if value is not None else ""
@@ -77,6 +84,8 @@ class HkbString(XmlValueHandler):
 
 
 class HkbInteger(XmlValueHandler):
+    __slots__ = ("signed", "byte_size")
+
     @classmethod
     def new(cls, tagfile: Tagfile, type_id: str, value: int = None) -> "HkbInteger":
         val = int(value) if value is not None else 0
@@ -111,6 +120,8 @@ class HkbInteger(XmlValueHandler):
 
 
 class HkbFloat(XmlValueHandler):
+    __slots__ = ()
+
     @classmethod
     def new(cls, tagfile: Tagfile, type_id: str, value: float = None) -> "HkbFloat":
         elem = HkbXmlElement.new("real", dec="", hex="")
@@ -165,6 +176,8 @@ class HkbFloat(XmlValueHandler):
 
 
 class HkbBool(XmlValueHandler):
+    __slots__ = ()
+
     @classmethod
     def new(cls, tagfile: Tagfile, type_id: str, value: bool = None) -> "HkbBool":
         bval = bool(value) if value is not None else False
@@ -192,6 +205,8 @@ class HkbBool(XmlValueHandler):
 
 
 class HkbPointer(XmlValueHandler):
+    __slots__ = ("subtype_id",)
+
     @classmethod
     def new(cls, tagfile: Tagfile, type_id: str, value: str = None) -> "HkbPointer":
         val = str(value) if value else "object0"
@@ -274,6 +289,7 @@ class HkbPointer(XmlValueHandler):
             raise ValueError("Target reference does not exist")
 
         self.element.set("id", str(oid))
+        self.tagfile.invalidate_root_paths()
 
     def get_target(self) -> "HkbRecord":
         oid = self.get_value()
@@ -290,6 +306,8 @@ class HkbPointer(XmlValueHandler):
 
 
 class HkbArray(XmlValueHandler, Generic[T]):
+    __slots__ = ("max_size", "is_pointer_array")
+
     @classmethod
     def new(
         cls,
@@ -351,6 +369,12 @@ class HkbArray(XmlValueHandler, Generic[T]):
     @_count.setter
     def _count(self, new_count: int) -> None:
         self.element.set("count", str(new_count))
+        self._on_items_moved()
+
+    def _on_items_moved(self) -> None:
+        # Array indices are part of the attribute paths leading to objects
+        if self.get_item_wrapper() in (HkbPointer, HkbRecord, HkbArray):
+            self.tagfile.invalidate_root_paths()
 
     def __len__(self) -> int:
         return self._count
@@ -433,6 +457,15 @@ class HkbArray(XmlValueHandler, Generic[T]):
         Handler = self.get_item_wrapper()
         return Handler.new(self.tagfile, self.element_type_id, value)
 
+    def _wrap_values(self, values: "HkbArray | list[T | Any]") -> list[T]:
+        ret = []
+        for v in values:
+            if isinstance(v, XmlValueHandler):
+                self._verify_compatible(v)
+            ret.append(self._wrap_value(v))
+
+        return ret
+
     def get_resolved_values(self) -> list:
         return [x.get_value() for x in self]
 
@@ -450,12 +483,7 @@ class HkbArray(XmlValueHandler, Generic[T]):
 
         with self.element.try_transaction():
             # Can't use clear as it would remove the attributes as well
-            for child in list(self.element):
-                self.element.remove(child)
-
-            for v in values:
-                self.element.append(v.element)
-
+            self.element.splice(0, len(self.element), [v.element for v in values])
             self._count = len(values)
 
     def index(self, value: T | Any) -> int:
@@ -515,15 +543,127 @@ class HkbArray(XmlValueHandler, Generic[T]):
         del self[index]
         return ret
 
+    def extend(self, values: "HkbArray | list[T | Any]") -> list[T]:
+        """Add several new items to the end of this array in one step.
+
+        Like append, this will always create new items.
+
+        Parameters
+        ----------
+        values : HkbArray | list[T | Any]
+            The items to add.
+
+        Returns
+        -------
+        list[T]
+            The new items that have been added to the array.
+        """
+        values = self._wrap_values(values)
+        if not values:
+            return []
+
+        with self.element.try_transaction():
+            self.element.extend([v.element for v in values])
+            self._count += len(values)
+
+        return values
+
+    def delete_indices(self, indices: Iterable[int]) -> list[T]:
+        """Remove several items from this array in one step.
+
+        Parameters
+        ----------
+        indices : Iterable[int]
+            Indices of the items to remove. Negative indices are allowed, duplicates will be ignored.
+
+        Returns
+        -------
+        list[T]
+            The removed items in their original order.
+        """
+        size = len(self)
+        drop = set()
+
+        for idx in indices:
+            if idx < 0:
+                idx = size + idx
+            if not 0 <= idx < size:
+                raise IndexError(f"Invalid index {idx}")
+            drop.add(idx)
+
+        if not drop:
+            return []
+
+        children = list(self.element)
+        removed = [children[i] for i in sorted(drop)]
+        keep = [c for i, c in enumerate(children) if i not in drop]
+
+        with self.element.try_transaction():
+            self.element.splice(0, len(children), keep)
+            self._count = len(keep)
+
+        return [wrap_element(self.tagfile, e, self.element_type_id) for e in removed]
+
+    def permute(self, order: list[int]) -> None:
+        """Reorder the items of this array in one step.
+
+        Parameters
+        ----------
+        order : list[int]
+            For each new position the index of the item that should be placed there, i.e. new_array[i] = old_array[order[i]].
+        """
+        size = len(self)
+        if len(order) != size or sorted(order) != list(range(size)):
+            raise ValueError(f"{order} is not a permutation of {size} items")
+
+        if all(i == idx for i, idx in enumerate(order)):
+            return
+
+        children = list(self.element)
+        self.element.splice(0, size, [children[idx] for idx in order])
+        self._on_items_moved()
+
+    def replace_slice(
+        self, start: int, stop: int, values: "HkbArray | list[T | Any]"
+    ) -> list[T]:
+        """Replace the items in [start:stop] with new items in one step. The number of new items may differ from the number of replaced items.
+
+        Parameters
+        ----------
+        start : int
+            First index to replace.
+        stop : int
+            Index after the last item to replace.
+        values : HkbArray | list[T | Any]
+            The new items.
+
+        Returns
+        -------
+        list[T]
+            The new items that have been placed in the array.
+        """
+        start, stop, _ = slice(start, stop).indices(len(self))
+        stop = max(start, stop)
+        values = self._wrap_values(values)
+
+        with self.element.try_transaction():
+            self.element.splice(start, stop, [v.element for v in values])
+            self._count = len(self) - (stop - start) + len(values)
+
+        return values
+
     def clear(self) -> None:
-        for child in self.element:
-            self.element.remove(child)
+        with self.element.try_transaction():
+            self.element.splice(0, len(self.element), [])
+            self._count = 0
 
     def __str__(self):
         return f"HkbArray[{self.element_type_name}] (len={self._count})"
 
 
 class HkbRecord(XmlValueHandler):
+    __slots__ = ("object_id", "_fields")
+
     @classmethod
     def new(
         cls,
@@ -593,8 +733,10 @@ class HkbRecord(XmlValueHandler):
         assert element.tag == "record"
         assert type_id
 
-        super().__init__(tagfile, element, type_id)
-        self.object_id = object_id
+        # Records are kept for every object, so share the strings with the type
+        # registry and the object cache
+        super().__init__(tagfile, element, sys.intern(type_id))
+        self.object_id = sys.intern(object_id) if object_id else object_id
         self._fields = tagfile.type_registry.get_field_types(type_id)
 
     def get_value(self) -> dict[str, XmlValueHandler]:
@@ -840,27 +982,34 @@ class HkbRecord(XmlValueHandler):
         return f"HkbRecord<{self.type_name}>({self.object_id})"
 
 
+_format_handlers = {
+    0: None,  # Void
+    1: None,  # Opaque
+    2: HkbBool,
+    3: HkbString,
+    4: HkbInteger,
+    5: HkbFloat,
+    6: HkbPointer,
+    7: HkbRecord,
+    8: HkbArray,
+}
+
+
 def get_value_handler(
     type_registry: TypeRegistry, type_id: str
 ) -> Type[XmlValueHandler]:
-    format_map = {
-        0: None,  # Void
-        1: None,  # Opaque
-        2: HkbBool,
-        3: HkbString,
-        4: HkbInteger,
-        5: HkbFloat,
-        6: HkbPointer,
-        7: HkbRecord,
-        8: HkbArray,
-    }
+    # Cached on the registry so that it is shared by all tagfiles using it
+    tp = type_registry.handlers.get(type_id)
+    if tp is not None:
+        return tp
 
     format = type_registry.get_format(type_id)
-    tp = format_map[format & 0xF]
+    tp = _format_handlers[format & 0xF]
 
     if tp is None:
         raise TypeError(f"Don't know how to handle type_id {type_id} (format={format})")
 
+    type_registry.handlers[type_id] = tp
     return tp
 
 
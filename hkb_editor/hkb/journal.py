@@ -0,0 +1,353 @@
+from typing import TYPE_CHECKING
+import os
+import re
+import json
+import time
+import logging
+from glob import glob, escape
+from threading import Thread
+
+from lxml import etree as ET
+
+from .xml import Delta, apply_delta
+
+if TYPE_CHECKING:
+    from .tagfile import Tagfile
+
+
+# Journals and snapshots are stored next to the behavior file and numbered by
+# generation. Journal N holds the changes on top of snapshot N, while generation 0 is
+# based on the last full save of the file itself.
+_journal_pattern = re.compile(r"\.journal\.(\d+)$")
+_snapshot_pattern = re.compile(r"\.snapshot\.(\d+)\.xml$")
+
+
+def _journal_path(file_path: str, generation: int) -> str:
+    return f"{file_path}.journal.{generation}"
+
+
+def _snapshot_path(file_path: str, generation: int) -> str:
+    return f"{file_path}.snapshot.{generation}.xml"
+
+
+def _find_generations(file_path: str, pattern: re.Pattern) -> list[int]:
+    generations = []
+    for path in glob(escape(file_path) + ".*"):
+        m = pattern.search(path[len(file_path) :])
+        if m:
+            generations.append(int(m.group(1)))
+
+    return sorted(generations)
+
+
+def _file_signature(file_path: str) -> list[int]:
+    stat = os.stat(file_path)
+    return [stat.st_size, stat.st_mtime_ns]
+
+
+def has_journal(file_path: str) -> bool:
+    """Check whether there are journaled changes for a file that were never saved, e.g. because the editor crashed.
+
+    Parameters
+    ----------
+    file_path : str
+        Path of the behavior file.
+
+    Returns
+    -------
+    bool
+        True if there are unsaved changes that can be recovered.
+    """
+    if _find_generations(file_path, _snapshot_pattern):
+        return True
+
+    for gen in _find_generations(file_path, _journal_pattern):
+        with open(_journal_path(file_path, gen)) as f:
+            # The first line is the header
+            f.readline()
+            if f.readline():
+                return True
+
+    return False
+
+
+def discard_journal(file_path: str) -> None:
+    """Delete all journals and snapshots of a file.
+
+    Parameters
+    ----------
+    file_path : str
+        Path of the behavior file.
+    """
+    for gen in _find_generations(file_path, _journal_pattern):
+        _remove(_journal_path(file_path, gen))
+
+    for gen in _find_generations(file_path, _snapshot_pattern):
+        _remove(_snapshot_path(file_path, gen))
+
+
+def _remove(path: str) -> None:
+    try:
+        os.remove(path)
+    except OSError as e:
+        logging.getLogger().warning(f"Failed to remove {path}: {e}")
+
+
+def get_recovery_base(file_path: str) -> str:
+    """Get the file the journaled changes of a file have to be replayed on. This is either the most recent complete snapshot or the file itself.
+
+    Parameters
+    ----------
+    file_path : str
+        Path of the behavior file.
+
+    Returns
+    -------
+    str
+        Path of the file to load before calling [recover_journal][].
+    """
+    snapshots = _find_generations(file_path, _snapshot_pattern)
+    if snapshots:
+        return _snapshot_path(file_path, snapshots[-1])
+
+    return file_path
+
+
+def recover_journal(tagfile: "Tagfile", file_path: str = None) -> int:
+    """Replay the journaled changes of a file onto a tagfile. All changes are applied in a single transaction, so the recovery can be undone.
+
+    Parameters
+    ----------
+    tagfile : Tagfile
+        The tagfile to restore. Must have been freshly loaded from the file returned by [get_recovery_base][].
+    file_path : str, optional
+        Path of the behavior file the journal belongs to. Defaults to the tagfile's file.
+
+    Returns
+    -------
+    int
+        The number of recovered changes, not counting snapshots.
+    """
+    if file_path is None:
+        file_path = tagfile.file
+
+    snapshots = _find_generations(file_path, _snapshot_pattern)
+    journals = _find_generations(file_path, _journal_pattern)
+    logger = logging.getLogger()
+
+    base = snapshots[-1] if snapshots else 0
+    journals = [gen for gen in journals if gen >= base]
+    root = tagfile._tree
+    # Shared by all deltas so that objects don't have to be searched every time
+    objects = {}
+    num_changes = 0
+
+    with tagfile.transaction():
+        for gen in journals:
+            with open(_journal_path(file_path, gen)) as f:
+                lines = f.readlines()
+
+            if not lines:
+                continue
+
+            try:
+                header = json.loads(lines[0])
+            except json.JSONDecodeError:
+                continue
+
+            signature = header.get("base")
+            if gen == 0 and signature != _file_signature(file_path):
+                logger.warning(
+                    f"{os.path.basename(file_path)} was modified after the journal was started, skipping recovery"
+                )
+                break
+
+            for line in lines[1:]:
+                try:
+                    deltas = json.loads(line)
+                except json.JSONDecodeError:
+                    # Incomplete write, anything after this is lost
+                    break
+
+                for delta in deltas:
+                    apply_delta(root, delta, objects)
+
+                num_changes += 1
+
+    tagfile._regenerate_cache()
+    return num_changes
+
+
+class Journal:
+    """Append-only log of all changes made to a tagfile since it was last saved, allowing to recover them after a crash.
+
+    Changes are taken from the tagfile's undo stack and written as soon as a mutation or transaction completes. Once the journal grows too large it is compacted by writing a full snapshot in the background and starting a new journal on top of it.
+
+    Parameters
+    ----------
+    tagfile : Tagfile
+        The tagfile to track. Must have undo enabled.
+    compact_size : int, optional
+        Size in bytes after which the journal is compacted.
+    sync_interval : float, optional
+        Journal writes are always flushed to the OS, which protects against crashes of the editor. To survive power loss they are also synced to disk, but at most once per this many seconds.
+    """
+
+    def __init__(
+        self,
+        tagfile: "Tagfile",
+        compact_size: int = 8 << 20,
+        sync_interval: float = 1.0,
+    ):
+        if not tagfile.is_undo_enabled():
+            raise ValueError("Journaling requires undo to be enabled")
+
+        self.tagfile = tagfile
+        self.compact_size = compact_size
+        self.sync_interval = sync_interval
+
+        self.logger = logging.getLogger(self.__class__.__name__)
+        self._file_path: str = None
+        self._generation = 0
+        self._journal = None
+        self._last_sync = 0.0
+        self._compaction: Thread = None
+
+    @property
+    def generation(self) -> int:
+        return self._generation
+
+    def start(self, keep_changes: bool = False) -> None:
+        """Begin journaling the changes made to the tagfile.
+
+        Parameters
+        ----------
+        keep_changes : bool, optional
+            Set this if the tagfile already contains changes that were not saved, e.g. after recovering a previous journal. A snapshot is written first and existing journals are only discarded once it is complete. Otherwise any existing journals are discarded immediately.
+        """
+        self._file_path = self.tagfile.file
+
+        if keep_changes:
+            existing = _find_generations(
+                self._file_path, _journal_pattern
+            ) + _find_generations(self._file_path, _snapshot_pattern)
+            self._generation = max(existing, default=0)
+            self._attach()
+            self.compact(wait=True)
+        else:
+            discard_journal(self._file_path)
+            self._generation = 0
+            self._open_journal({"base": _file_signature(self._file_path)})
+            self._attach()
+
+    def reset(self) -> None:
+        """Discard the journal after the tagfile has been saved and start over. The tagfile may have been saved to a different file."""
+        self.close(discard=True)
+        self.start()
+
+    def close(self, discard: bool = False) -> None:
+        """Stop journaling.
+
+        Parameters
+        ----------
+        discard : bool, optional
+            Delete the journal, e.g. because the changes were saved or deliberately abandoned. Otherwise it will be available for recovery the next time the file is opened.
+        """
+        undo_stack = self.tagfile._tree.undo_stack
+        if undo_stack.journal == self._write:
+            undo_stack.journal = None
+
+        if self._compaction:
+            self._compaction.join()
+            self._compaction = None
+
+        if self._journal:
+            self._journal.close()
+            self._journal = None
+
+        if discard and self._file_path:
+            discard_journal(self._file_path)
+
+    def compact(self, wait: bool = False) -> None:
+        """Write a full snapshot of the tagfile in the background and continue with a new, empty journal.
+
+        Parameters
+        ----------
+        wait : bool, optional
+            If the previous snapshot is still being written, wait for it to complete and compact again. Otherwise this compaction is skipped, which is only safe if the journal still describes all changes.
+        """
+        if self._compaction and self._compaction.is_alive():
+            if not wait:
+                return
+
+            self._compaction.join()
+
+        # Serializing must happen before any further changes are made
+        data = ET.tostring(self.tagfile._tree, encoding="utf-8")
+
+        self._generation += 1
+        generation = self._generation
+        self._open_journal({"base": "snapshot"})
+
+        def write_snapshot():
+            path = _snapshot_path(self._file_path, generation)
+            tmp = path + ".tmp"
+
+            try:
+                with open(tmp, "wb") as f:
+                    f.write(data)
+                    f.flush()
+                    os.fsync(f.fileno())
+
+                os.replace(tmp, path)
+            except OSError as e:
+                self.logger.error(f"Failed to write snapshot: {e}")
+                return
+
+            # Anything older is now covered by the snapshot
+            for gen in _find_generations(self._file_path, _journal_pattern):
+                if gen < generation:
+                    _remove(_journal_path(self._file_path, gen))
+
+            for gen in _find_generations(self._file_path, _snapshot_pattern):
+                if gen < generation:
+                    _remove(_snapshot_path(self._file_path, gen))
+
+            self.logger.debug(f"Wrote snapshot {generation} ({len(data)} bytes)")
+
+        self._compaction = Thread(target=write_snapshot, daemon=True)
+        self._compaction.start()
+
+    def _attach(self) -> None:
+        self.tagfile._tree.undo_stack.journal = self._write
+
+    def _open_journal(self, header: dict) -> None:
+        if self._journal:
+            self._journal.close()
+
+        header["generation"] = self._generation
+        self._journal = open(_journal_path(self._file_path, self._generation), "w")
+        self._journal.write(json.dumps(header) + "\n")
+        self._sync(force=True)
+
+    def _sync(self, force: bool = False) -> None:
+        self._journal.flush()
+
+        now = time.monotonic()
+        if force or now - self._last_sync >= self.sync_interval:
+            os.fsync(self._journal.fileno())
+            self._last_sync = now
+
+    def _write(self, deltas: tuple[Delta, ...]) -> None:
+        if deltas is None:
+            # A change we can't describe, e.g. undoing something from before the
+            # journal was started. The snapshot must not be skipped, otherwise the
+            # change would be missing when recovering
+            self.compact(wait=True)
+            return
+
+        self._journal.write(json.dumps(deltas, separators=(",", ":")) + "\n")
+        self._sync()
+
+        if self._journal.tell() >= self.compact_size:
+            self.compact()
@@ -0,0 +1,339 @@
+from typing import Any, Iterable, TYPE_CHECKING
+from dataclasses import dataclass, field
+from collections import deque
+from types import FunctionType, MethodType, ModuleType, MappingProxyType
+import functools
+import os
+import sys
+import tracemalloc
+import psutil
+
+from lxml import etree as ET
+
+from .tagfile import Tagfile
+
+if TYPE_CHECKING:
+    from .behavior import HavokBehavior
+
+
+# The xml tree lives in libxml2 and is invisible to python's memory tools, so its size
+# is estimated from the structs libxml2 allocates on 64 bit systems (including malloc
+# overhead): one xmlNode per element, one xmlAttr plus a text node per attribute, and
+# a text node per non-empty text or tail
+_node_size = 136
+_attr_size = 112
+_text_size = 136 + 16
+
+
+def estimate_tree_size(element: ET._Element) -> int:
+    """Estimate the native memory occupied by an xml subtree.
+
+    Parameters
+    ----------
+    element : ET._Element
+        Root of the subtree.
+
+    Returns
+    -------
+    int
+        Approximate size in bytes.
+    """
+    size = 0
+
+    for elem in element.iter():
+        size += _node_size
+
+        # Comments have no attributes
+        if isinstance(elem.tag, str):
+            for value in elem.attrib.values():
+                size += _attr_size + _text_size + len(value)
+
+        if elem.text:
+            size += _text_size + len(elem.text)
+
+        if elem.tail:
+            size += _text_size + len(elem.tail)
+
+    return size
+
+
+def deep_size(
+    obj: Any, seen: dict[int, Any] = None, tree_root: ET._Element = None
+) -> int:
+    """Approximate the memory held by an object and everything it references.
+
+    Modules, classes and tagfiles are not followed. Xml elements are counted by their estimated native size, unless they are part of the tree of `tree_root`, which is accounted for separately.
+
+    Parameters
+    ----------
+    obj : Any
+        The object to measure.
+    seen : dict[int, Any], optional
+        Objects that have been counted already by their IDs. Will be updated, so that several calls can share it to avoid counting objects twice.
+    tree_root : ET._Element, optional
+        Root of a tree whose elements should not be counted.
+
+    Returns
+    -------
+    int
+        Approximate size in bytes.
+    """
+    if seen is None:
+        seen = {}
+
+    size = 0
+    todo = deque([obj])
+
+    while todo:
+        obj = todo.pop()
+        if id(obj) in seen:
+            continue
+
+        # Keep a reference so the ID can't be reused while the dict is in use
+        seen[id(obj)] = obj
+
+        if isinstance(obj, (type, ModuleType, Tagfile)):
+            continue
+
+        if isinstance(obj, ET._Element):
+            root = obj.getroottree().getroot()
+            if root is not tree_root and id(root) not in seen:
+                # Detached elements, e.g. removed objects kept alive by the undo
+                # stack. Count the whole detached tree once.
+                seen[id(root)] = root
+                size += sys.getsizeof(obj) + estimate_tree_size(root)
+            continue
+
+        size += sys.getsizeof(obj)
+
+        if isinstance(obj, (dict, MappingProxyType)):
+            todo.extend(obj.keys())
+            todo.extend(obj.values())
+        elif isinstance(obj, (list, tuple, set, frozenset, deque)):
+            todo.extend(obj)
+        elif isinstance(obj, FunctionType):
+            for cell in obj.__closure__ or ():
+                try:
+                    todo.append(cell.cell_contents)
+                except ValueError:
+                    # Empty cell, e.g. a closure variable that has not been assigned yet
+                    pass
+            if obj.__defaults__:
+                todo.extend(obj.__defaults__)
+        elif isinstance(obj, MethodType):
+            todo.append(obj.__self__)
+        elif isinstance(obj, functools.partial):
+            todo.append(obj.func)
+            todo.extend(obj.args)
+            todo.extend(obj.keywords.values())
+        elif not isinstance(obj, (str, bytes, int, float, bool)) and obj is not None:
+            if hasattr(obj, "__dict__"):
+                todo.append(vars(obj))
+
+            for cls in type(obj).__mro__:
+                for slot in getattr(cls, "__slots__", ()):
+                    if slot not in ("__dict__", "__weakref__"):
+                        todo.append(getattr(obj, slot, None))
+
+    return size
+
+
+@dataclass
+class MemoryReport:
+    """Approximate memory usage of a behavior, see [memory_report][].
+
+    Parameters
+    ----------
+    subsystems : dict[str, int]
+        Bytes by part of the model, e.g. the xml tree or the undo stack.
+    by_type : dict[str, int]
+        Bytes of the objects' xml and records by Havok type name.
+    top_objects : list[tuple[str, str, int]]
+        The largest objects as tuples of object ID, type name and bytes.
+    resident : int
+        Resident size of the whole process.
+    traced : list[tuple[str, int]], optional
+        Python allocations by source file if tracemalloc is tracing, largest first.
+    notes : list[str], optional
+        Additional information, e.g. about things that could not be measured.
+    """
+
+    subsystems: dict[str, int]
+    by_type: dict[str, int]
+    top_objects: list[tuple[str, str, int]]
+    resident: int
+    traced: list[tuple[str, int]] = None
+    notes: list[str] = field(default_factory=list)
+
+    def format(self, top: int = 20) -> str:
+        """Render the report as plain text.
+
+        Parameters
+        ----------
+        top : int, optional
+            Maximum number of rows to show for types, objects and traced files.
+
+        Returns
+        -------
+        str
+            The formatted report.
+        """
+
+        def mb(num_bytes: int) -> str:
+            return f"{num_bytes / (1 << 20):9.2f} MB"
+
+        accounted = sum(self.subsystems.values())
+        lines = [f"Resident size {mb(self.resident)}", "", "By subsystem:"]
+
+        for name, size in sorted(self.subsystems.items(), key=lambda x: -x[1]):
+            lines.append(f"  {name:<24}{mb(size)}")
+
+        lines.append(f"  {'(not accounted for)':<24}{mb(self.resident - accounted)}")
+
+        lines += ["", f"By type (top {top}):"]
+        by_type = sorted(self.by_type.items(), key=lambda x: -x[1])
+        for type_name, size in by_type[:top]:
+            lines.append(f"  {type_name:<40}{mb(size)}")
+
+        lines += ["", f"Largest objects (top {top}):"]
+        for object_id, type_name, size in self.top_objects[:top]:
+            lines.append(f"  {object_id:<14}{type_name:<40}{mb(size)}")
+
+        if self.traced is not None:
+            lines += ["", f"Traced python allocations by file (top {top}):"]
+            for file_name, size in self.traced[:top]:
+                lines.append(f"  {file_name:<40}{mb(size)}")
+
+        if self.notes:
+            lines += [""] + self.notes
+
+        return "\n".join(lines)
+
+
+def _traced_by_file() -> list[tuple[str, int]]:
+    snapshot = tracemalloc.take_snapshot()
+    snapshot = snapshot.filter_traces(
+        [tracemalloc.Filter(False, tracemalloc.__file__)]
+    )
+
+    by_file: dict[str, int] = {}
+    for stat in snapshot.statistics("filename"):
+        file_name = stat.traceback[0].filename
+        # Show our own modules relative to the package
+        parts = file_name.replace("\\", "/").split("/hkb_editor/")
+        if len(parts) > 1:
+            short = "hkb_editor/" + parts[-1]
+        else:
+            short = os.path.basename(file_name)
+
+        by_file[short] = by_file.get(short, 0) + stat.size
+
+    return sorted(by_file.items(), key=lambda x: -x[1])
+
+
+def memory_report(
+    behavior: "HavokBehavior",
+    *,
+    top: int = 20,
+    extra: dict[str, Iterable[Any]] = None,
+) -> MemoryReport:
+    """Walk a behavior and estimate how much memory its parts occupy.
+
+    Python objects are measured with `sys.getsizeof`, while the xml tree held by libxml2 is estimated from its structure. If tracemalloc is tracing (e.g. when running with `-X tracemalloc`), a snapshot of all python allocations grouped by source file is included as well.
+
+    Parameters
+    ----------
+    behavior : HavokBehavior
+        The behavior to inspect.
+    top : int, optional
+        Number of largest objects to keep.
+    extra : dict[str, Iterable[Any]], optional
+        Additional subsystems to measure, e.g. indices or GUI state owned by the caller. Each iterable's items are measured with [deep_size][], not counting anything that belongs to the behavior.
+
+    Returns
+    -------
+    MemoryReport
+        The report.
+    """
+    # Take the snapshot before walking the model allocates anything itself
+    traced = _traced_by_file() if tracemalloc.is_tracing() else None
+
+    tree_root = behavior._tree
+    subsystems: dict[str, int] = {}
+    by_type: dict[str, int] = {}
+    objects: list[tuple[str, str, int]] = []
+    # Shared between all measurements so nothing is counted twice
+    seen: dict[int, Any] = {}
+
+    # Shared by all tagfiles with the same types. Measured first so that records
+    # referencing its field mappings don't count them.
+    subsystems["type registry (shared)"] = deep_size(
+        behavior.type_registry, seen, tree_root
+    )
+
+    # Objects, both their xml and their cached records
+    tree_objects = 0
+    records = sys.getsizeof(behavior.objects)
+    for object_id, record in behavior.objects.items():
+        xml_size = estimate_tree_size(record.element.getparent())
+        record_size = (
+            deep_size(object_id, seen)
+            + deep_size(record, seen, tree_root)
+            + sys.getsizeof(record.element)
+        )
+
+        tree_objects += xml_size
+        records += record_size
+
+        type_name = record.type_name
+        size = xml_size + record_size
+        by_type[type_name] = by_type.get(type_name, 0) + size
+        objects.append((object_id, type_name, size))
+
+    subsystems["xml tree (objects)"] = tree_objects
+    subsystems["xml tree (other)"] = estimate_tree_size(tree_root) - tree_objects
+    subsystems["object cache"] = records
+
+    # The cached name arrays of behaviors
+    name_arrays = 0
+    for attr in ("_events", "_variables", "_animations"):
+        cached = getattr(behavior, attr, None)
+        if cached is not None:
+            name_arrays += deep_size(cached._cache, seen, tree_root)
+
+    if name_arrays:
+        subsystems["name arrays"] = name_arrays
+
+    undo_stack = tree_root.undo_stack
+    if undo_stack:
+        # Listeners belong to whoever registered them (usually the GUI)
+        seen[id(undo_stack._listeners)] = undo_stack._listeners
+        subsystems["undo stack"] = deep_size(
+            [undo_stack._undos, undo_stack._redos], seen, tree_root
+        )
+
+    subsystems["indices"] = deep_size(behavior._root_paths, seen, tree_root)
+
+    for name, items in (extra or {}).items():
+        subsystems[name] = sum(deep_size(item, seen, tree_root) for item in items)
+
+    objects.sort(key=lambda x: -x[2])
+
+    report = MemoryReport(
+        subsystems=subsystems,
+        by_type=by_type,
+        top_objects=objects[:top],
+        resident=psutil.Process().memory_info().rss,
+        traced=traced,
+    )
+
+    if traced is None:
+        report.notes.append(
+            "Run with -X tracemalloc to include traced python allocations."
+        )
+
+    report.notes.append(
+        "Xml tree sizes are estimated, native memory of other libraries (e.g. dearpygui) is only part of the resident size."
+    )
+
+    return report
@@ -0,0 +1,208 @@
+from typing import Callable
+from hashlib import blake2b
+from lxml import etree as ET
+
+from hkb_editor.hkb.tagfile import Tagfile
+from hkb_editor.hkb.behavior import HavokBehavior
+from hkb_editor.hkb.index_attributes import (
+    event_attributes,
+    variable_attributes,
+    animation_attributes,
+)
+
+
+# Index attributes are hashed by the name they refer to, as indices will usually differ
+# between behaviors
+_index_attributes: dict[str, dict[str, str]] = {}
+for _kind, _attributes in (
+    ("event", event_attributes),
+    ("variable", variable_attributes),
+    ("animation", animation_attributes),
+):
+    for _type_name, _paths in _attributes.items():
+        for _path in _paths:
+            _index_attributes.setdefault(_type_name, {})[_path] = _kind
+
+
+class RecordHasher:
+    """Calculates structural content hashes for behavior objects.
+
+    A hash covers the object's type name and all of its field values, but not its object ID. Pointers are hashed by the hash of the object they point to, index attributes (events, variables, animations) by the name they refer to, and types by name instead of ID. Two objects with the same hash thus describe the same content and hierarchy, even if they come from different files.
+
+    Hashes are calculated lazily and cached, so the hasher should not outlive any modifications of the objects it has seen.
+
+    Parameters
+    ----------
+    lookup_object : Callable[[str], tuple[str, ET._Element]]
+        Returns the type name and record element of an object ID, or None if the object does not exist.
+    lookup_type_name : Callable[[str], str]
+        Returns the name of a type ID.
+    lookup_index_name : Callable[[str, int], str], optional
+        Returns the name of an event, variable or animation index. The first argument will be one of "event", "variable" or "animation". If not provided indices will be hashed as they are.
+    """
+
+    def __init__(
+        self,
+        lookup_object: Callable[[str], tuple[str, ET._Element]],
+        lookup_type_name: Callable[[str], str],
+        lookup_index_name: Callable[[str, int], str] = None,
+    ):
+        self._lookup_object = lookup_object
+        self._lookup_type_name = lookup_type_name
+        self._lookup_index_name = lookup_index_name
+        self._hashes: dict[str, bytes] = {}
+        self._pending: set[str] = set()
+
+    @classmethod
+    def from_tagfile(cls, tagfile: Tagfile) -> "RecordHasher":
+        """Create a hasher for the objects of a tagfile. If the tagfile is a behavior, index attributes will be resolved to their names.
+
+        Parameters
+        ----------
+        tagfile : Tagfile
+            The tagfile to hash objects of.
+
+        Returns
+        -------
+        RecordHasher
+            A new hasher.
+        """
+        registry = tagfile.type_registry
+
+        def lookup_object(object_id: str) -> tuple[str, ET._Element]:
+            obj = tagfile.objects.get(object_id)
+            if obj is None:
+                return None
+            return (obj.type_name, obj.element)
+
+        lookup_index_name = None
+        if isinstance(tagfile, HavokBehavior):
+            getters = {
+                "event": tagfile.get_event,
+                "variable": tagfile.get_variable_name,
+                "animation": tagfile.get_animation,
+            }
+
+            def lookup_index_name(kind: str, idx: int) -> str:
+                return getters[kind](idx, None)
+
+        return cls(lookup_object, registry.get_name, lookup_index_name)
+
+    @classmethod
+    def from_hierarchy(cls, xml: ET._Element) -> "RecordHasher":
+        """Create a hasher for the objects of an exported hierarchy (see `clone_hierarchy.write_hierarchies`). The type IDs of the hierarchy are resolved immediately, so later modifications of the objects' typeids will not affect the hashes.
+
+        Parameters
+        ----------
+        xml : ET._Element
+            Root element of the hierarchy document.
+
+        Returns
+        -------
+        RecordHasher
+            A new hasher.
+        """
+        type_names = {t.get("id"): t.get("name") for t in xml.iterfind("types/type")}
+        objects = {
+            obj.get("id"): (type_names.get(obj.get("typeid")), obj.find("record"))
+            for obj in xml.iterfind("objects/object")
+        }
+        indices = {
+            kind: {int(e.get("idx")): e.get("name") for e in xml.iterfind(path)}
+            for kind, path in (
+                ("event", "events/event"),
+                ("variable", "variables/variable"),
+                ("animation", "animations/animation"),
+            )
+        }
+
+        def lookup_index_name(kind: str, idx: int) -> str:
+            return indices[kind].get(idx)
+
+        return cls(objects.get, type_names.get, lookup_index_name)
+
+    def get_hash(self, object_id: str) -> bytes:
+        """Get the content hash of an object.
+
+        Parameters
+        ----------
+        object_id : str
+            ID of the object to hash.
+
+        Returns
+        -------
+        bytes
+            The object's content hash, or None if the object does not exist.
+        """
+        digest = self._hashes.get(object_id)
+        if digest is not None:
+            return digest
+
+        # Cyclic references are hashed as a placeholder
+        if object_id in self._pending:
+            return b"<cycle>"
+
+        entry = self._lookup_object(object_id)
+        if entry is None:
+            return None
+
+        type_name, record = entry
+        h = blake2b(digest_size=16)
+        h.update(f"{type_name}\0".encode())
+
+        self._pending.add(object_id)
+        try:
+            self._update(h, record, "", _index_attributes.get(type_name))
+        finally:
+            self._pending.discard(object_id)
+
+        digest = h.digest()
+        self._hashes[object_id] = digest
+        return digest
+
+    def _update(
+        self, h: "blake2b", elem: ET._Element, path: str, index_paths: dict[str, str]
+    ) -> None:
+        tag = elem.tag
+
+        if tag == "record":
+            h.update(b"{%d" % len(elem))
+            for field in elem:
+                name = field.get("name")
+                h.update(f"{name}\0".encode())
+                field_path = f"{path}/{name}" if path else name
+                for child in field:
+                    self._update(h, child, field_path, index_paths)
+            h.update(b"}")
+
+        elif tag == "array":
+            element_type = self._lookup_type_name(elem.get("elementtypeid"))
+            h.update(f"[{element_type}\0{len(elem)}".encode())
+            for child in elem:
+                self._update(h, child, f"{path}:*", index_paths)
+            h.update(b"]")
+
+        elif tag == "pointer":
+            target_id = elem.get("id")
+            if not target_id or target_id == "object0":
+                h.update(b"p\0")
+            else:
+                h.update(b"p" + (self.get_hash(target_id) or b"<missing>"))
+
+        elif tag == "real":
+            value = float(elem.get("dec", "0").replace(",", "."))
+            h.update(f"r{value!r}\0".encode())
+
+        elif tag == "integer":
+            value = elem.get("value")
+            if index_paths and self._lookup_index_name and path in index_paths:
+                idx = int(value)
+                if idx >= 0:
+                    name = self._lookup_index_name(index_paths[path], idx)
+                    h.update(f"n{name}\0".encode())
+                    return
+            h.update(f"i{value}\0".encode())
+
+        else:
+            # string, bool and anything else with a value attribute
+            h.update(f"{tag}\0{elem.get('value')}\0".encode())
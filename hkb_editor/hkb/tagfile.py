@@ -1,5 +1,6 @@
-from typing import Any, Callable, Generator, Iterator, TYPE_CHECKING
+from typing import Any, Callable, Generator, Iterable, Iterator, TYPE_CHECKING
 import logging
+import sys
 from collections import deque
 from contextlib import contextmanager
 from copy import deepcopy
@@ -10,7 +11,13 @@ import re
 from lxml import etree as ET
 import networkx as nx
 
-from .xml import xml_from_file, add_type_comments, HkbXmlElement, MutationType
+from .xml import (
+    xml_from_file,
+    add_type_comments,
+    HkbXmlElement,
+    MutationType,
+    MutationListener,
+)
 from .type_registry import TypeRegistry
 from .query import query_objects
 
@@ -27,23 +34,33 @@ class Tagfile:
         xml_file: str,
         undo: bool = False,
         root_object_type: str = "hkRootLevelContainer",
+        progress: Callable[[str], None] = None,
     ):
         from .hkb_types import HkbRecord
 
+        # Called with the name of each loading stage before it starts. May raise to
+        # abort loading. Only used while the constructor runs.
+        self._progress = progress
+
         self.file = xml_file
+        self._report_progress("parse")
         self._tree: HkbXmlElement = xml_from_file(xml_file, undo=undo)
 
+        # Shortest paths from the behavior root, see _get_root_paths
+        self._root_paths: dict[str, list[tuple[str, str]]] = None
+
         # Some versions of HKLib seem to decompile floats with commas
         self.floats_use_commas = bool(
             self._tree.xpath("(//real[contains(@dec, ',')])[1]")
         )
 
-        self.type_registry = TypeRegistry()
-        self.type_registry.load_types(self._tree)
+        self._report_progress("types")
+        self.type_registry = TypeRegistry.from_xml(self._tree)
 
         # TODO hide behind a property, changing this dict should also affect the xml
         # TODO cache objects by name and type_name for quick access
         self.objects: dict[str, HkbRecord] = {}
+        self._report_progress("objects")
         self._regenerate_cache()
 
         objectid_values = [
@@ -53,14 +70,25 @@ class Tagfile:
         ]
         self._next_object_id = max(objectid_values, default=0) + 1
         self.behavior_root: HkbRecord = self.find_first_by_type_name(root_object_type)
+        self._progress = None
+
+    def _report_progress(self, stage: str) -> None:
+        if self._progress:
+            self._progress(stage)
 
     def _regenerate_cache(self) -> None:
         from .hkb_types import HkbRecord
 
-        self.objects = {
-            obj.get("id"): HkbRecord.from_object(self, obj)
-            for obj in self._tree.findall(".//object")
-        }
+        records = (
+            HkbRecord.from_object(self, obj) for obj in self._tree.findall(".//object")
+        )
+        # Keyed by the records' interned IDs so both share the same string
+        self.objects = {record.object_id: record for record in records}
+        self.invalidate_root_paths()
+
+    def invalidate_root_paths(self) -> None:
+        """Discard the cached paths from the behavior root. Must be called whenever pointers are changed or pointers are moved to different attribute paths (e.g. by inserting into an array). This is done automatically by the value handlers."""
+        self._root_paths = None
 
     def is_undo_enabled(self) -> bool:
         """Check whether undo is supported for the underlying xml tree.
@@ -115,6 +143,23 @@ class Tagfile:
 
         return None
 
+    def add_mutation_listener(self, listener: MutationListener) -> None:
+        """Register a function to be called whenever the xml structure is changed, including undo and redo. Requires undo to be enabled.
+
+        Parameters
+        ----------
+        listener : MutationListener
+            Called with the mutation type and the changed xml elements.
+        """
+        undo_stack = self._tree.undo_stack
+        if undo_stack:
+            undo_stack.add_listener(listener)
+
+    def remove_mutation_listener(self, listener: MutationListener) -> None:
+        undo_stack = self._tree.undo_stack
+        if undo_stack:
+            undo_stack.remove_listener(listener)
+
     def can_undo(self) -> bool:
         """Check if there are actions to undo.
 
@@ -134,10 +179,16 @@ class Tagfile:
         ActionType
             The type of the mutation that was undone, or None if there was nothing to undo.
         """
-        ret = self._tree.undo_stack.undo()
+        undo_stack = self._tree.undo_stack
+        ret = undo_stack.undo()
         if ret == MutationType.STRUCTURE:
             # So far we only cache structure elements, not attributes
             self._regenerate_cache()
+        elif ret is not None:
+            # Pointers are attributes, too
+            self.invalidate_root_paths()
+
+        undo_stack.notify()
         return ret
 
     def can_redo(self) -> bool:
@@ -159,10 +210,16 @@ class Tagfile:
         ActionType
             The type of the mutation that was redone, or None if there was nothing to redo.
         """
-        ret = self._tree.undo_stack.redo()
+        undo_stack = self._tree.undo_stack
+        ret = undo_stack.redo()
         if ret == MutationType.STRUCTURE:
             # So far we only cache structure elements, not attributes
             self._regenerate_cache()
+        elif ret is not None:
+            # Pointers are attributes, too
+            self.invalidate_root_paths()
+
+        undo_stack.notify()
         return ret
 
     def save_to_file(self, file_path: str) -> None:
@@ -180,7 +237,11 @@ class Tagfile:
         # changes to the graph
         return self.build_graph(self.behavior_root.object_id)
 
-    def build_graph(self, root_id: str):
+    def build_graph(self, root_id: str | Iterable[str]):
+        """Build a graph of all objects reachable from the specified root object(s).
+
+        Passing several roots will explore the shared parts of their hierarchies only once.
+        """
         g = nx.DiGraph()
 
         visited = set()
@@ -197,9 +258,10 @@ class Tagfile:
             )
             visited.add(parent_id)
 
-        root = self.objects[root_id]
-        expand(root.element, root_id)
-        g.add_node(root_id)
+        root_ids = [root_id] if isinstance(root_id, str) else list(root_id)
+        for rid in root_ids:
+            expand(self.objects[rid].element, rid)
+            g.add_node(rid)
 
         logger = logging.getLogger()
 
@@ -210,7 +272,7 @@ class Tagfile:
 
             obj = self.objects.get(pointer_id)
             if obj:
-                g.add_edge(parent_id, pointer_id)
+                g.add_edge(parent_id, obj.object_id)
                 expand(obj.element, obj.object_id)
             else:
                 logger.warning(
@@ -232,6 +294,129 @@ class Tagfile:
 
         return None
 
+    def _iter_pointer_paths(
+        self, record_elem: HkbXmlElement
+    ) -> Generator[tuple[str, str], None, None]:
+        # Same paths as HkbRecord.find_fields_by_class(HkbPointer), but works directly on
+        # the xml so we don't have to create handlers for every field
+        todo: list[tuple[str, HkbXmlElement]] = [("", record_elem)]
+
+        while todo:
+            path, elem = todo.pop()
+
+            if elem.tag == "pointer":
+                oid = elem.get("id")
+                if oid and oid != "object0":
+                    yield (path, oid)
+            elif elem.tag == "record":
+                # Reversed so that fields are popped in document order
+                for field in reversed(elem):
+                    name = field.get("name")
+                    field_path = f"{path}/{name}" if path else name
+                    todo.extend((field_path, val) for val in field)
+            elif elem.tag == "array":
+                todo.extend(
+                    (f"{path}:{i}", item) for i, item in reversed(list(enumerate(elem)))
+                )
+
+    def _get_root_paths(self) -> dict[str, list[tuple[str, str]]]:
+        # Breadth first tree from the behavior root. For every reachable object we keep
+        # all parents on a shortest path together with the attribute path of the
+        # pointer leading to the object, so unique paths can be recovered by walking
+        # upwards.
+        if self._root_paths is not None:
+            return self._root_paths
+
+        root_id = self.behavior_root.object_id
+        depth = {root_id: 0}
+        parents: dict[str, list[tuple[str, str]]] = {root_id: []}
+        todo = deque([root_id])
+        logger = logging.getLogger()
+
+        while todo:
+            parent_id = todo.popleft()
+            child_depth = depth[parent_id] + 1
+            seen = set()
+
+            for attr_path, oid in self._iter_pointer_paths(
+                self.objects[parent_id].element
+            ):
+                # Only the first pointer to a child matters for the paths
+                if oid in seen:
+                    continue
+
+                seen.add(oid)
+
+                child = self.objects.get(oid)
+                if child is None:
+                    logger.warning(
+                        f"Object {parent_id} is referencing non-existing object {oid}"
+                    )
+                    continue
+
+                # The paths are cached, so avoid keeping copies of the same strings
+                oid = child.object_id
+                attr_path = sys.intern(attr_path)
+
+                d = depth.get(oid)
+                if d is None:
+                    depth[oid] = child_depth
+                    parents[oid] = [(parent_id, attr_path)]
+                    todo.append(oid)
+                elif d == child_depth:
+                    parents[oid].append((parent_id, attr_path))
+
+        self._root_paths = parents
+        return parents
+
+    def _walk_root_paths(
+        self, target_id: str
+    ) -> Generator[list[tuple[str, str]], None, None]:
+        parents = self._get_root_paths()
+        if target_id not in parents:
+            raise nx.NetworkXNoPath(
+                f"Target {target_id} cannot be reached from {self.behavior_root.object_id}"
+            )
+
+        # Each item is a partial path (as hops from the target upwards)
+        todo: list[tuple[str, list[tuple[str, str]]]] = [(target_id, [])]
+
+        while todo:
+            oid, hops = todo.pop()
+            hop_parents = parents[oid]
+
+            if not hop_parents:
+                yield hops[::-1]
+                continue
+
+            for parent_id, attr_path in reversed(hop_parents):
+                todo.append((parent_id, hops + [(parent_id, attr_path)]))
+
+    def get_root_path_ids(self, target_id: "str | HkbRecord") -> list[str]:
+        """Get the object IDs along one shortest path from the behavior root to the target object (both included).
+
+        Parameters
+        ----------
+        target_id : str | HkbRecord
+            The object you want to locate.
+
+        Returns
+        -------
+        list[str]
+            Object IDs from the behavior root to the target object, or an empty list if the object cannot be reached.
+        """
+        from .hkb_types import HkbRecord
+
+        if isinstance(target_id, HkbRecord):
+            target_id = target_id.object_id
+
+        try:
+            hops = next(self._walk_root_paths(target_id))
+        except nx.NetworkXNoPath:
+            return []
+
+        return [oid for oid, _ in hops] + [target_id]
+
     def get_unique_object_paths(
         self, target_id: "str | HkbRecord"
     ) -> Generator[list[str], None, None]:
@@ -261,24 +446,13 @@ class Tagfile:
         Generator[list[str], None, None]
             Unique paths to reach the target object from the behavior root.
         """
-        from .hkb_types import HkbPointer
-
-        root_paths = nx.all_shortest_paths(
-            self.root_graph(), self.behavior_root.object_id, target_id
-        )
+        from .hkb_types import HkbRecord
 
-        for path in root_paths:
-            chain = []
-            # Last element is the object itself
-            for idx, node_id in enumerate(path[:-1]):
-                obj: HkbRecord = self.objects[node_id]
-                next_node = path[idx + 1]
-                for attr_path, ptr in obj.find_fields_by_class(HkbPointer):
-                    if ptr.get_value() == next_node:
-                        chain.append(attr_path)
-                        break
+        if isinstance(target_id, HkbRecord):
+            target_id = target_id.object_id
 
-            yield chain
+        for hops in self._walk_root_paths(target_id):
+            yield [attr_path for _, attr_path in hops]
 
     def resolve_unique_object_path(
         self, object_path: list[str], default: Any = _undefined
@@ -519,6 +693,9 @@ class Tagfile:
             self._tree.append(record.as_object())
             self.objects[id] = record
 
+        # Dangling pointers might have been referencing this ID
+        self.invalidate_root_paths()
+
         return id
 
     def delete_object(self, object_id: "HkbRecord | str") -> "HkbRecord":
@@ -557,6 +734,7 @@ class Tagfile:
             else:
                 parent.remove(obj.element)
 
+        self.invalidate_root_paths()
         return obj
 
     def __len__(self) -> int:
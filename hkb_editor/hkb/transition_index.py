@@ -0,0 +1,119 @@
+from dataclasses import dataclass
+
+from hkb_editor.hkb import HavokBehavior, HkbRecord, HkbArray, HkbPointer
+
+
+@dataclass(frozen=True, slots=True)
+class EventTransition:
+    """A transition that is triggered by an event.
+
+    Parameters
+    ----------
+    statemachine_id : str
+        Object ID of the statemachine the transition belongs to.
+    source_state_id : str
+        Object ID of the StateInfo the transition starts from, or None for wildcard transitions.
+    transitions_id : str
+        Object ID of the TransitionInfoArray containing the transition.
+    index : int
+        Index of the transition within the TransitionInfoArray.
+    target_state_id : str
+        Object ID of the StateInfo the transition leads to, or None if the statemachine has no state with the transition's toStateId.
+    """
+
+    statemachine_id: str
+    source_state_id: str
+    transitions_id: str
+    index: int
+    target_state_id: str
+
+    @property
+    def is_wildcard(self) -> bool:
+        return self.source_state_id is None
+
+
+class TransitionIndex:
+    """Maps event names to the wildcard and state transitions they trigger, so that incoming events can be resolved without searching the behavior.
+
+    The index is built once and rebuilt on demand when the behavior has been modified.
+
+    Parameters
+    ----------
+    behavior : HavokBehavior
+        The behavior to index.
+    """
+
+    def __init__(self, behavior: HavokBehavior):
+        self.behavior = behavior
+        self._transitions: dict[str, tuple[EventTransition, ...]] = {}
+        self._undo_id = None
+        self.rebuild()
+
+    def is_outdated(self) -> bool:
+        return self.behavior.top_undo_id() != self._undo_id
+
+    def rebuild(self) -> None:
+        behavior = self.behavior
+        events = behavior.get_events()
+        transitions: dict[str, list[EventTransition]] = {}
+
+        def collect(
+            sm: HkbRecord,
+            source_state_id: str,
+            transitions_ptr: HkbPointer,
+            states_by_id: dict[int, str],
+        ) -> None:
+            transitions_array = transitions_ptr.get_target()
+            if transitions_array is None:
+                return
+
+            items: HkbArray = transitions_array["transitions"]
+            for idx, transition in enumerate(items):
+                event_id = transition["eventId"].get_value()
+                if not 0 <= event_id < len(events):
+                    continue
+
+                to_state = transition["toStateId"].get_value()
+                transitions.setdefault(events[event_id], []).append(
+                    EventTransition(
+                        sm.object_id,
+                        source_state_id,
+                        transitions_array.object_id,
+                        idx,
+                        states_by_id.get(to_state),
+                    )
+                )
+
+        sm_type = behavior.type_registry.find_first_type_by_name("hkbStateMachine")
+        for sm in behavior.find_objects_by_type(sm_type):
+            states: list[HkbRecord] = []
+            for ptr in sm["states"]:
+                state = ptr.get_target()
+                if state is not None:
+                    states.append(state)
+
+            states_by_id = {s["stateId"].get_value(): s.object_id for s in states}
+
+            collect(sm, None, sm["wildcardTransitions"], states_by_id)
+            for state in states:
+                collect(sm, state.object_id, state["transitions"], states_by_id)
+
+        self._transitions = {
+            event: tuple(items) for event, items in transitions.items()
+        }
+        self._undo_id = behavior.top_undo_id()
+
+    def get_transitions(self, event: str) -> tuple[EventTransition, ...]:
+        """Get all transitions that may be triggered by an event.
+
+        Parameters
+        ----------
+        event : str
+            Name of the event.
+
+        Returns
+        -------
+        tuple[EventTransition, ...]
+            The transitions that use the event, empty if there are none.
+        """
+        return self._transitions.get(event, ())
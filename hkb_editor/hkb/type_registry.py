@@ -1,14 +1,24 @@
-from typing import TYPE_CHECKING, Any, Generator
+from typing import TYPE_CHECKING, Any, Generator, Type
 from logging import getLogger
 from functools import cache
+from types import MappingProxyType
+import hashlib
+import sys
+import threading
 from lxml import etree as ET
 
 if TYPE_CHECKING:
-    from .hkb_types import HkbRecord
+    from .hkb_types import HkbRecord, XmlValueHandler
 
 
 _logger = getLogger(__name__)
 
+# Registries don't change once loaded, so tagfiles with identical types can share one.
+# There are only ever a few distinct type sections (usually one per game), so they are
+# kept for the lifetime of the program.
+_shared_registries: dict[str, "TypeRegistry"] = {}
+_shared_registries_lock = threading.Lock()
+
 
 class TypeMismatch(Exception):
     def __init__(self, message: str, missing: list[str], extra: list[str]):
@@ -20,36 +30,95 @@ class TypeMismatch(Exception):
 class TypeRegistry:
     def __init__(self):
         self.types: dict[str, dict] = {}
+        # Hash of the type definitions this registry was loaded from
+        self.types_hash: str = None
+        # Value handler classes by type ID, see get_value_handler
+        self.handlers: dict[str, Type["XmlValueHandler"]] = {}
+
+    @classmethod
+    def from_xml(cls, root: ET._Element) -> "TypeRegistry":
+        """Get a registry for the types defined in an xml tree. Registries are shared between all trees with identical type definitions and must not be modified.
+
+        Parameters
+        ----------
+        root : ET._Element
+            Root of the xml tree.
+
+        Returns
+        -------
+        TypeRegistry
+            A loaded type registry.
+        """
+        type_elements = cls._find_type_elements(root)
+        types_hash = cls.hash_types(type_elements)
+
+        with _shared_registries_lock:
+            registry = _shared_registries.get(types_hash)
+
+        if registry is None:
+            registry = cls()
+            registry._load_type_elements(type_elements)
+            registry.types_hash = types_hash
+
+            with _shared_registries_lock:
+                # Another thread may have loaded the same types in the meantime
+                registry = _shared_registries.setdefault(types_hash, registry)
+
+        return registry
+
+    @staticmethod
+    def hash_types(type_elements: list[ET._Element]) -> str:
+        h = hashlib.blake2b(digest_size=16)
+        for type_el in type_elements:
+            h.update(ET.tostring(type_el, with_tail=False))
+
+        return h.hexdigest()
+
+    @staticmethod
+    def _find_type_elements(root: ET._Element) -> list[ET._Element]:
+        # Types are usually top level elements, so avoid searching the entire tree
+        return root.findall("type") or root.findall(".//type")
 
     def load_types(self, root: ET._Element) -> None:
-        self.types.clear()
+        self._load_type_elements(self._find_type_elements(root))
+
+    def _load_type_elements(self, type_elements: list[ET._Element]) -> None:
+        intern = sys.intern
+        types: dict[str, dict] = {}
+        self.handlers = {}
+
+        type_elements_by_id = {el.attrib["id"]: el for el in type_elements}
 
-        for type_el in root.findall(".//type"):
-            type_id = type_el.attrib["id"]
-            name = type_el.find("name").attrib["value"]
+        for type_el in type_elements:
+            type_id = intern(type_el.attrib["id"])
+            name = intern(type_el.find("name").attrib["value"])
 
             # Seems to be inherited from the parent types
-            fmt = self._collect_typeinfo(root, type_id, "format", "value")
+            fmt = self._collect_typeinfo(
+                type_elements_by_id, type_id, "format", "value"
+            )
             if not fmt:
                 _logger.warning("Could not resolve format of type %s", type_id)
                 fmt = 0
             else:
                 fmt = int(fmt[0])
 
-            fields = {
-                f: ft
-                for f, ft in self._collect_typeinfo(
-                    root, type_id, "field", ("name", "typeid")
-                )
-            }
+            fields = MappingProxyType(
+                {
+                    intern(f): intern(ft)
+                    for f, ft in self._collect_typeinfo(
+                        type_elements_by_id, type_id, "field", ("name", "typeid")
+                    )
+                }
+            )
 
             typeparams = (
-                [
-                    tp.attrib["id"]
+                tuple(
+                    intern(tp.attrib["id"])
                     for tp in type_el.find("parameters").findall("typeparam")
-                ]
+                )
                 if type_el.find("parameters") is not None
-                else []
+                else ()
             )
 
             subtype = self._get_attribute(type_el, "subtype", "id")
@@ -58,7 +127,7 @@ class TypeRegistry:
             # TODO field flags
             # https://github.com/The12thAvenger/HKLib/blob/main/HKLib.Reflection/HavokType.cs#L82
 
-            self.types[type_id] = {
+            types[type_id] = {
                 "name": name,
                 "format": fmt,
                 "fields": fields,
@@ -67,26 +136,31 @@ class TypeRegistry:
                 "parent": parent,
             }
 
-        for type_id, info in self.types.items():
+        for type_id, info in types.items():
             subtype = info["subtype"]
-            if subtype in self.types:
-                subname = self.types[subtype]["name"]
-                fullname = f"{info['name']}< {subname} >"
+            if subtype in types:
+                subname = types[subtype]["name"]
+                fullname = intern(f"{info['name']}< {subname} >")
             else:
                 fullname = info["name"]
 
             info["fullname"] = fullname
 
+        self.types = MappingProxyType(
+            {type_id: MappingProxyType(info) for type_id, info in types.items()}
+        )
+
     def _get_attribute(self, elem: ET._Element, tag: str, key: str) -> str:
         attr_el = elem.find(tag)
         if attr_el is not None:
-            return attr_el.attrib.get(key, None)
+            value = attr_el.attrib.get(key, None)
+            return sys.intern(value) if value is not None else None
 
         return None
 
     def _collect_typeinfo(
         self,
-        root: ET._Element,
+        type_elements: dict[str, ET._Element],
         leaf_type_id: str,
         attr_tag: str,
         attributes: str | tuple[str],
@@ -97,7 +171,7 @@ class TypeRegistry:
         ret = []
 
         while leaf_type_id:
-            type_el = root.find(f".//type[@id='{leaf_type_id}']")
+            type_el = type_elements[leaf_type_id]
             level_vals = []
 
             for attr_el in type_el.findall(f".//{attr_tag}"):
@@ -3,14 +3,26 @@ import re
 from pathlib import Path
 import networkx as nx
 
-from hkb_editor.hkb import HavokBehavior, HkbRecord, HkbArray, HkbPointer
-from hkb_editor.hkb.index_attributes import (
+from .behavior import HavokBehavior
+from .hkb_types import HkbRecord, HkbArray, HkbPointer
+from .index_attributes import (
     event_attributes,
     variable_attributes,
     animation_attributes,
 )
-from .update_name_ids import get_nameidfile_folder
-from hkb_editor.hkb.hkb_flags import hkbBlenderGenerator_Flags
+from .hkb_flags import hkbBlenderGenerator_Flags
+
+
+def get_nameidfile_folder(behavior: HavokBehavior) -> Path:
+    # Default paths
+    # Behaviors will usually be located in
+    # mod/chr/cXXXX-behbnd-dcx/Behavior/cXXXX.xml
+    # and we are looking for the name ID files in
+    # mod/action/
+    try:
+        return Path(behavior.file).parents[3] / "action"
+    except IndexError:
+        return None
 
 
 def _safe_pointer_get(ptr: HkbPointer) -> HkbRecord:
@@ -223,9 +235,19 @@ def check_nameidfiles(behavior: HavokBehavior, logger: logging.Logger) -> None:
         logger.error(f"{variableids_file} not found, please copy it from the game folder")
 
 
-def verify_behavior(behavior: HavokBehavior) -> None:
-    logger = logging.getLogger("verify")
-    
+def verify_behavior(behavior: HavokBehavior, logger: logging.Logger = None) -> None:
+    """Run all checks on a behavior. Problems are not returned but logged as warnings, errors and critical messages.
+
+    Parameters
+    ----------
+    behavior : HavokBehavior
+        The behavior to check.
+    logger : logging.Logger, optional
+        The logger to report problems to.
+    """
+    if logger is None:
+        logger = logging.getLogger("verify")
+
     check_xml(behavior, logger)
     check_statemachines(behavior, logger)
     check_attributes(behavior, logger)
@@ -0,0 +1,275 @@
+from typing import Callable, Generator, Iterator, TYPE_CHECKING
+from dataclasses import dataclass
+from concurrent.futures import ThreadPoolExecutor, as_completed
+import os
+import logging
+
+from .behavior import HavokBehavior
+
+if TYPE_CHECKING:
+    from .hkb_types import HkbRecord
+    from .journal import Journal
+
+
+def _normalize_path(file_path: str) -> str:
+    return os.path.normcase(os.path.abspath(file_path))
+
+
+def load_behaviors(
+    file_paths: list[str],
+    *,
+    load_fn: Callable[[str], HavokBehavior] = None,
+    max_workers: int = None,
+    on_loaded: Callable[[str, HavokBehavior], None] = None,
+    on_error: Callable[[str, Exception], None] = None,
+) -> list[HavokBehavior]:
+    """Load several behaviors in parallel.
+
+    Loading happens in a thread pool rather than in separate processes, as the parsed XML trees cannot be passed between processes. Conversions of HKX files and binders run in external tools and will overlap, while parsing and indexing the XML is mostly bound by the GIL.
+
+    Parameters
+    ----------
+    file_paths : list[str]
+        The files to load.
+    load_fn : Callable[[str], HavokBehavior], optional
+        Loads a single behavior. By default the files are expected to be XML and loaded with undo enabled.
+    max_workers : int, optional
+        Maximum number of files to load at the same time. Defaults to the number of files, but at most the number of CPUs.
+    on_loaded : Callable[[str, HavokBehavior], None], optional
+        Called with the file path and the behavior whenever a file has been loaded. Called from the thread that called this function.
+    on_error : Callable[[str, Exception], None], optional
+        Called with the file path and the exception if a file fails to load. If not set, the first error is raised once all other files have finished loading.
+
+    Returns
+    -------
+    list[HavokBehavior]
+        The behaviors that were loaded successfully, in the order of the file paths.
+    """
+    if not file_paths:
+        return []
+
+    if load_fn is None:
+        load_fn = lambda path: HavokBehavior(path, undo=True)
+
+    if max_workers is None:
+        max_workers = min(len(file_paths), os.cpu_count() or 1)
+
+    loaded: dict[str, HavokBehavior] = {}
+    first_error: Exception = None
+
+    with ThreadPoolExecutor(max_workers=max_workers) as executor:
+        futures = {executor.submit(load_fn, path): path for path in file_paths}
+
+        for future in as_completed(futures):
+            path = futures[future]
+            try:
+                beh = future.result()
+            except Exception as e:
+                if on_error:
+                    on_error(path, e)
+                elif first_error is None:
+                    first_error = e
+                continue
+
+            loaded[path] = beh
+            if on_loaded:
+                on_loaded(path, beh)
+
+    if first_error is not None:
+        raise first_error
+
+    return [loaded[path] for path in file_paths if path in loaded]
+
+
+@dataclass(eq=False)
+class WorkspaceEntry:
+    """A behavior in a workspace together with the state that has to be kept for it while other behaviors are active.
+
+    Parameters
+    ----------
+    behavior : HavokBehavior
+        The loaded behavior.
+    journal : Journal, optional
+        The crash recovery journal of the behavior, if any.
+    last_save_undo_id : int, optional
+        The undo ID the behavior was last saved at. -1 if it was never modified, None if it differs from the file even without any undo actions.
+    """
+
+    behavior: HavokBehavior
+    journal: "Journal" = None
+    last_save_undo_id: int = -1
+
+    @property
+    def file(self) -> str:
+        return self.behavior.file
+
+    @property
+    def name(self) -> str:
+        return os.path.basename(self.behavior.file)
+
+    def has_unsaved_changes(self) -> bool:
+        return self.behavior.top_undo_id() != self.last_save_undo_id
+
+
+class Workspace:
+    """A set of loaded behaviors, one of which is active.
+
+    Every behavior keeps its own undo stack and indices, so operations spanning several files (e.g. searching or copying hierarchies) can run against the loaded models instead of reopening the files.
+    """
+
+    def __init__(self):
+        self.logger = logging.getLogger(self.__class__.__name__)
+        self.entries: list[WorkspaceEntry] = []
+        self.active: WorkspaceEntry = None
+
+    def __len__(self) -> int:
+        return len(self.entries)
+
+    def __iter__(self) -> Iterator[WorkspaceEntry]:
+        # Allows to modify the workspace while iterating
+        return iter(list(self.entries))
+
+    def __contains__(self, behavior: HavokBehavior) -> bool:
+        return self.get_entry(behavior) is not None
+
+    @property
+    def behaviors(self) -> list[HavokBehavior]:
+        return [entry.behavior for entry in self.entries]
+
+    def get_entry(self, behavior: HavokBehavior) -> WorkspaceEntry:
+        for entry in self.entries:
+            if entry.behavior is behavior:
+                return entry
+
+        return None
+
+    def find(self, file_path: str) -> WorkspaceEntry:
+        """Find the entry of a loaded file.
+
+        Parameters
+        ----------
+        file_path : str
+            Path of the behavior file.
+
+        Returns
+        -------
+        WorkspaceEntry
+            The entry, or None if the file is not part of the workspace.
+        """
+        file_path = _normalize_path(file_path)
+        for entry in self.entries:
+            if _normalize_path(entry.file) == file_path:
+                return entry
+
+        return None
+
+    def add(self, behavior: HavokBehavior, activate: bool = False) -> WorkspaceEntry:
+        """Add a behavior to the workspace. If the same file was loaded before, the previous behavior is replaced.
+
+        Parameters
+        ----------
+        behavior : HavokBehavior
+            The behavior to add.
+        activate : bool, optional
+            Whether to make the behavior the active one. The first behavior added is always activated.
+
+        Returns
+        -------
+        WorkspaceEntry
+            The new entry.
+        """
+        entry = WorkspaceEntry(behavior)
+
+        previous = self.find(behavior.file)
+        if previous:
+            idx = self.entries.index(previous)
+            self._close_entry(previous)
+            self.entries[idx] = entry
+
+            if self.active is previous:
+                self.active = entry
+        else:
+            self.entries.append(entry)
+
+        if activate or self.active is None:
+            self.active = entry
+
+        return entry
+
+    def remove(self, entry: WorkspaceEntry) -> None:
+        """Remove a behavior from the workspace. If it was active, another behavior will become active. Its journal is closed but kept for recovery.
+
+        Parameters
+        ----------
+        entry : WorkspaceEntry
+            The entry to remove.
+        """
+        if entry not in self.entries:
+            return
+
+        idx = self.entries.index(entry)
+        self.entries.pop(idx)
+        self._close_entry(entry)
+
+        if self.active is entry:
+            if self.entries:
+                self.active = self.entries[min(idx, len(self.entries) - 1)]
+            else:
+                self.active = None
+
+    def _close_entry(self, entry: WorkspaceEntry) -> None:
+        if entry.journal:
+            # Keep the journal in case there were unsaved changes
+            entry.journal.close()
+            entry.journal = None
+
+    def load(
+        self,
+        file_paths: list[str],
+        *,
+        load_fn: Callable[[str], HavokBehavior] = None,
+        max_workers: int = None,
+        on_error: Callable[[str, Exception], None] = None,
+    ) -> list[WorkspaceEntry]:
+        """Load several behaviors in parallel and add them to the workspace. See [load_behaviors][] for details.
+
+        Returns
+        -------
+        list[WorkspaceEntry]
+            The entries of the behaviors that were loaded successfully.
+        """
+        behaviors = load_behaviors(
+            file_paths, load_fn=load_fn, max_workers=max_workers, on_error=on_error
+        )
+        return [self.add(beh) for beh in behaviors]
+
+    def has_unsaved_changes(self) -> bool:
+        return any(entry.has_unsaved_changes() for entry in self.entries)
+
+    def query(self, query_str: str, **kwargs) -> Generator["HkbRecord", None, None]:
+        """Run a query against all behaviors in the workspace, starting with the active one. Use the records' `tagfile` to tell which behavior they belong to. See [Tagfile.query][] for the query syntax.
+
+        Parameters
+        ----------
+        query_str : str
+            The query to run.
+        kwargs : dict
+            Additional arguments passed to [Tagfile.query][].
+
+        Yields
+        ------
+        HkbRecord
+            Iterator over matching records of all behaviors.
+
+        Raises
+        ------
+        ValueError
+            If the query has invalid syntax.
+        """
+        entries = list(self.entries)
+        if self.active in entries:
+            entries.remove(self.active)
+            entries.insert(0, self.active)
+
+        for entry in entries:
+            yield from entry.behavior.query(query_str, **kwargs)
@@ -17,12 +17,28 @@ class MutationType(IntEnum):
     STRUCTURE = 2
 
 
+# A serializable description of a mutation: the operation, the path to the changed
+# element (see element_path) and the operation's arguments. See apply_delta.
+Delta = tuple
+
+
 @dataclass(slots=True)
 class UndoAction:
     id: int
     action_type: MutationType
     undo_fn: Callable
     redo_fn: Callable
+    # Elements whose attributes, text or children are changed by this action
+    elements: tuple = ()
+    # Only recorded while a journal is attached to the undo stack
+    redo_deltas: tuple[Delta, ...] = None
+    undo_deltas: tuple[Delta, ...] = None
+
+
+MutationListener = Callable[[MutationType, tuple["HkbXmlElement", ...]], None]
+# Receives the deltas of every mutation, undo and redo, or None if a change could not be
+# described by deltas
+MutationJournal = Callable[[tuple[Delta, ...]], None]
 
 
 class UndoStack:
@@ -32,20 +48,98 @@ class UndoStack:
         self._action_id = 0
         self._max_size = max_size
         self._transaction_buffer: list[UndoAction] = None
+        self._listeners: list[MutationListener] = []
+        self._unnotified: UndoAction = None
+        self._unjournaled: tuple[Delta, ...] = ()
+        self.journal: MutationJournal = None
+
+    def add_listener(self, listener: MutationListener) -> None:
+        """Register a function to be called after every mutation, undo and redo. It will receive the mutation type and the elements that were changed. Mutations inside a transaction are reported once the transaction ends.
+
+        Parameters
+        ----------
+        listener : MutationListener
+            The function to call.
+        """
+        if listener not in self._listeners:
+            self._listeners.append(listener)
+
+    def remove_listener(self, listener: MutationListener) -> None:
+        if listener in self._listeners:
+            self._listeners.remove(listener)
+
+    def _notify(self, action: UndoAction) -> None:
+        for listener in list(self._listeners):
+            # The mutation has already been applied, a failing listener (usually GUI
+            # code) must neither fail it nor keep other listeners from being informed
+            try:
+                listener(action.action_type, action.elements)
+            except Exception as e:
+                logging.getLogger().error(
+                    f"Mutation listener {listener} failed: {e}", exc_info=e
+                )
+
+    def notify(self) -> None:
+        """Inform listeners about the last recorded mutation, undo or redo. Must be called once the change has been applied, does nothing inside transactions."""
+        action = self._unnotified
+        self._unnotified = None
+
+        deltas = self._unjournaled
+        self._unjournaled = ()
+        self._write_journal(deltas)
+
+        if action is not None:
+            self._notify(action)
+
+    def _write_journal(self, deltas: tuple[Delta, ...]) -> None:
+        # None means the change happened before the journal was attached
+        if self.journal and deltas != ():
+            self.journal(deltas)
+
+    def record(
+        self,
+        action_type: MutationType,
+        undo_fn: Callable,
+        redo_fn: Callable,
+        element: "HkbXmlElement" = None,
+        deltas: Callable[[], tuple[Delta, Delta]] = None,
+    ):
+        """Record a mutation before it is applied.
+
+        Parameters
+        ----------
+        action_type : MutationType
+            What kind of change the mutation makes.
+        undo_fn : Callable
+            Reverts the mutation.
+        redo_fn : Callable
+            Applies the mutation again.
+        element : HkbXmlElement, optional
+            The element whose attributes, text or children are changed.
+        deltas : Callable[[], tuple[Delta, Delta]], optional
+            Returns the deltas to apply and revert the mutation. Only called while a journal is attached.
+        """
+        elements = (element,) if element is not None else ()
+        action = UndoAction(self._action_id, action_type, undo_fn, redo_fn, elements)
+
+        if self.journal and deltas:
+            redo_delta, undo_delta = deltas()
+            action.redo_deltas = (redo_delta,) if redo_delta else ()
+            action.undo_deltas = (undo_delta,) if undo_delta else ()
 
-    def record(self, action_type: MutationType, undo_fn: Callable, redo_fn: Callable):
         if self._transaction_buffer is not None:
             # Inside a transaction - buffer the operation
-            self._transaction_buffer.append(
-                UndoAction(self._action_id, action_type, undo_fn, redo_fn)
-            )
+            self._transaction_buffer.append(action)
         else:
             # Normal operation - record immediately
-            self._undos.append(
-                UndoAction(self._action_id, action_type, undo_fn, redo_fn)
-            )
-            self._redos.clear()
-            self._action_id += 1
+            self._push(action)
+            self._unnotified = action
+            self._unjournaled = action.redo_deltas
+
+    def _push(self, action: UndoAction) -> None:
+        self._undos.append(action)
+        self._redos.clear()
+        self._action_id += 1
 
     @contextmanager
     def transaction(self):
@@ -75,6 +169,9 @@ class UndoStack:
 
             if operations:
                 action_type = max(a.action_type for a in operations)
+                elements = tuple(
+                    dict.fromkeys(e for a in operations for e in a.elements)
+                )
 
                 # Combine all operations into single undo/redo
                 def combined_undo():
@@ -87,7 +184,25 @@ class UndoStack:
                     for action in operations:
                         action.redo_fn()
 
-                self.record(action_type, combined_undo, combined_redo)
+                action = UndoAction(
+                    self._action_id,
+                    action_type,
+                    combined_undo,
+                    combined_redo,
+                    elements,
+                )
+
+                if all(a.redo_deltas is not None for a in operations):
+                    action.redo_deltas = tuple(
+                        d for a in operations for d in a.redo_deltas
+                    )
+                    action.undo_deltas = tuple(
+                        d for a in reversed(operations) for d in a.undo_deltas
+                    )
+
+                self._push(action)
+                self._write_journal(action.redo_deltas)
+                self._notify(action)
 
     def top_undo_id(self) -> int:
         if not self._undos:
@@ -115,6 +230,9 @@ class UndoStack:
         action = self._undos.pop()
         action.undo_fn()
         self._redos.append(action)
+        self._unjournaled = action.undo_deltas
+        # Listeners are informed once the caller has updated its state, see notify
+        self._unnotified = action
         return action.action_type
 
     def redo(self) -> MutationType:
@@ -124,6 +242,8 @@ class UndoStack:
         action = self._redos.pop()
         action.redo_fn()
         self._undos.append(action)
+        self._unnotified = action
+        self._unjournaled = action.redo_deltas
         return action.action_type
 
     def clear(self):
@@ -153,10 +273,18 @@ class UndoAttrib(dict):
             def redo():
                 self._attrib[key] = value
 
-            undo_stack.record(MutationType.ATTRIBUTE, undo, redo)
+            undo_stack.record(
+                MutationType.ATTRIBUTE,
+                undo,
+                redo,
+                element=self._element,
+                deltas=lambda: attrib_deltas(self._element, {key: value}, {key: old_value}),
+            )
 
         self._attrib[key] = value
         super().__setitem__(key, value)
+        if undo_stack is not None:
+            undo_stack.notify()
 
     def __delitem__(self, key: str):
         undo_stack = self._element.undo_stack
@@ -168,10 +296,16 @@ class UndoAttrib(dict):
                     MutationType.ATTRIBUTE, 
                     undo_fn=lambda: self._attrib.__setitem__(key, old_value),
                     redo_fn=lambda: self._attrib.pop(key, None),
+                    element=self._element,
+                    deltas=lambda: attrib_deltas(
+                        self._element, {key: None}, {key: old_value}
+                    ),
                 )
 
         self._attrib.pop(key, None)
         super().__delitem__(key)
+        if undo_stack is not None:
+            undo_stack.notify()
 
     def __getitem__(self, key: str):
         return self._attrib[key]
@@ -207,9 +341,15 @@ class UndoAttrib(dict):
                     MutationType.ATTRIBUTE, 
                     undo_fn=lambda: self._attrib.__setitem__(key, old_value),
                     redo_fn=lambda: self._attrib.pop(key, None),
+                    element=self._element,
+                    deltas=lambda: attrib_deltas(
+                        self._element, {key: None}, {key: old_value}
+                    ),
                 )
 
         result = self._attrib.pop(key, default)
+        if undo_stack is not None:
+            undo_stack.notify()
         if key in self:
             super().__delitem__(key)
         return result
@@ -231,10 +371,18 @@ class UndoAttrib(dict):
             def redo():
                 self._attrib.update(updates)
 
-            undo_stack.record(MutationType.ATTRIBUTE, undo, redo)
+            undo_stack.record(
+                MutationType.ATTRIBUTE,
+                undo,
+                redo,
+                element=self._element,
+                deltas=lambda: attrib_deltas(self._element, updates, old_values),
+            )
 
         self._attrib.update(updates)
         super().update(updates)
+        if undo_stack is not None:
+            undo_stack.notify()
 
     def clear(self):
         undo_stack = self._element.undo_stack
@@ -246,10 +394,16 @@ class UndoAttrib(dict):
                     MutationType.ATTRIBUTE, 
                     undo_fn=lambda: self._attrib.update(old_attrib),
                     redo_fn=lambda: self._attrib.clear(),
+                    element=self._element,
+                    deltas=lambda: attrib_deltas(
+                        self._element, dict.fromkeys(old_attrib), old_attrib
+                    ),
                 )
 
         self._attrib.clear()
         super().clear()
+        if undo_stack is not None:
+            undo_stack.notify()
 
     def setdefault(self, key: str, default: Any = None):
         if key not in self._attrib:
@@ -259,9 +413,15 @@ class UndoAttrib(dict):
                     MutationType.ATTRIBUTE, 
                     undo_fn=lambda: self._attrib.pop(key, None),
                     redo_fn=lambda: self._attrib.__setitem__(key, default),
+                    element=self._element,
+                    deltas=lambda: attrib_deltas(
+                        self._element, {key: default}, {key: None}
+                    ),
                 )
             self._attrib[key] = default
             super().__setitem__(key, default)
+            if undo_stack is not None:
+                undo_stack.notify()
 
         return self._attrib[key]
 
@@ -323,10 +483,18 @@ class HkbXmlElement(ET.ElementBase):
             def redo():
                 super(HkbXmlElement, __class__).text.__set__(self, value)
 
-            undo_stack.record(MutationType.TEXT, undo, redo)
+            undo_stack.record(
+                MutationType.TEXT,
+                undo,
+                redo,
+                element=self,
+                deltas=lambda: text_deltas(self, "text", value, old_text),
+            )
 
         # lxml is implemented in C and uses a "getset_descriptor" which works slightly different
         super(HkbXmlElement, __class__).text.__set__(self, value)
+        if undo_stack is not None:
+            undo_stack.notify()
 
     @property
     def tail(self) -> str:
@@ -339,14 +507,22 @@ class HkbXmlElement(ET.ElementBase):
             old_tail = self.tail
 
             def undo():
-                super(HkbXmlElement, __class__).text.__set__(self, old_tail)
+                super(HkbXmlElement, __class__).tail.__set__(self, old_tail)
 
             def redo():
-                super(HkbXmlElement, __class__).text.__set__(self, value)
+                super(HkbXmlElement, __class__).tail.__set__(self, value)
 
-            undo_stack.record(MutationType.TEXT, undo, redo)
+            undo_stack.record(
+                MutationType.TEXT,
+                undo,
+                redo,
+                element=self,
+                deltas=lambda: text_deltas(self, "tail", value, old_tail),
+            )
 
-        super(HkbXmlElement, __class__).text.__set__(self, value)
+        super(HkbXmlElement, __class__).tail.__set__(self, value)
+        if undo_stack is not None:
+            undo_stack.notify()
 
     def set(self, key: str, value: str):
         undo_stack = self.undo_stack
@@ -362,9 +538,17 @@ class HkbXmlElement(ET.ElementBase):
             def redo():
                 super(HkbXmlElement, self).set(key, value)
 
-            undo_stack.record(MutationType.ATTRIBUTE, undo, redo)
+            undo_stack.record(
+                MutationType.ATTRIBUTE,
+                undo,
+                redo,
+                element=self,
+                deltas=lambda: attrib_deltas(self, {key: value}, {key: old_value}),
+            )
 
         super(HkbXmlElement, self).set(key, value)
+        if undo_stack is not None:
+            undo_stack.notify()
 
     def __setitem__(self, key: str, value: str):
         undo_stack = self.undo_stack
@@ -380,9 +564,17 @@ class HkbXmlElement(ET.ElementBase):
             def redo():
                 super(HkbXmlElement, self).set(key, value)
 
-            undo_stack.record(MutationType.ATTRIBUTE, undo, redo)
+            undo_stack.record(
+                MutationType.ATTRIBUTE,
+                undo,
+                redo,
+                element=self,
+                deltas=lambda: attrib_deltas(self, {key: value}, {key: old_value}),
+            )
 
         super(HkbXmlElement, self).__setitem__(key, value)
+        if undo_stack is not None:
+            undo_stack.notify()
 
     def __delitem__(self, key: str):
         undo_stack = self.undo_stack
@@ -394,9 +586,13 @@ class HkbXmlElement(ET.ElementBase):
                     MutationType.ATTRIBUTE,
                     undo_fn=lambda: super(HkbXmlElement, self).set(key, old_value),
                     redo_fn=lambda: self.attrib.pop(key, None),
+                    element=self,
+                    deltas=lambda: attrib_deltas(self, {key: None}, {key: old_value}),
                 )
 
         super(HkbXmlElement, self).__delitem__(key)
+        if undo_stack is not None:
+            undo_stack.notify()
 
     def append(self, child) -> None:
         self._check_move(child)
@@ -406,21 +602,39 @@ class HkbXmlElement(ET.ElementBase):
                 MutationType.STRUCTURE,
                 undo_fn=lambda: super(HkbXmlElement, self).remove(child),
                 redo_fn=lambda: super(HkbXmlElement, self).append(child),
+                element=self,
+                deltas=lambda: append_deltas(self, [child]),
             )
 
         super(HkbXmlElement, self).append(child)
+        if undo_stack is not None:
+            undo_stack.notify()
+
+    def _restore_after(self, anchor, child) -> None:
+        # Undo actions are always executed in reverse order, so at this point the
+        # anchor is guaranteed to be the same sibling it was when we recorded it
+        if anchor is None:
+            super(HkbXmlElement, self).insert(0, child)
+        else:
+            ET.ElementBase.addnext(anchor, child)
 
     def remove(self, child) -> None:
         undo_stack = self.undo_stack
         if undo_stack is not None:
-            index = list(self).index(child)
+            # Finding the index would require iterating over all previous siblings,
+            # remembering the previous sibling instead is O(1)
+            anchor = child.getprevious()
             undo_stack.record(
                 MutationType.STRUCTURE,
-                undo_fn=lambda: super(HkbXmlElement, self).insert(index, child),
+                undo_fn=lambda: self._restore_after(anchor, child),
                 redo_fn=lambda: super(HkbXmlElement, self).remove(child),
+                element=self,
+                deltas=lambda: remove_deltas(self, child, anchor),
             )
 
         super(HkbXmlElement, self).remove(child)
+        if undo_stack is not None:
+            undo_stack.notify()
 
     def insert(self, index: int, child) -> None:
         self._check_move(child)
@@ -430,9 +644,13 @@ class HkbXmlElement(ET.ElementBase):
                 MutationType.STRUCTURE,
                 undo_fn=lambda: super(HkbXmlElement, self).remove(child),
                 redo_fn=lambda: super(HkbXmlElement, self).insert(index, child),
+                element=self,
+                deltas=lambda: splice_deltas(self, *_insert_range(self, index), [child]),
             )
 
         super(HkbXmlElement, self).insert(index, child)
+        if undo_stack is not None:
+            undo_stack.notify()
 
     def clear(self):
         undo_stack = self.undo_stack
@@ -454,9 +672,20 @@ class HkbXmlElement(ET.ElementBase):
             def redo():
                 super(HkbXmlElement, self).clear()
 
-            undo_stack.record(MutationType.STRUCTURE, undo, redo)
+            undo_stack.record(
+                MutationType.STRUCTURE,
+                undo,
+                redo,
+                element=self,
+                deltas=lambda: (
+                    ("element", element_path(self), f"<{self.tag}/>"),
+                    ("element", element_path(self), element_to_str(self)),
+                ),
+            )
 
         super(HkbXmlElement, self).clear()
+        if undo_stack is not None:
+            undo_stack.notify()
 
     def extend(self, elements: list):
         for e in elements:
@@ -472,27 +701,76 @@ class HkbXmlElement(ET.ElementBase):
                     super(HkbXmlElement, self).remove(e) for e in elements_list
                 ],
                 redo_fn=lambda: super(HkbXmlElement, self).extend(elements_list),
+                element=self,
+                deltas=lambda: append_deltas(self, elements_list),
             )
 
         super(HkbXmlElement, self).extend(elements)
+        if undo_stack is not None:
+            undo_stack.notify()
+
+    def splice(self, start: int, stop: int, new_children: list) -> None:
+        """Replace the children in [start:stop] by new_children in a single step.
+
+        Children may be moved around within this element (e.g. to reorder them), but
+        elements from other parents will be moved as well. Only one undo action is
+        recorded regardless of how many children are affected.
+        """
+        new_children = list(new_children)
+        for e in new_children:
+            if e.getparent() is not self:
+                self._check_move(e)
+
+        old_children = self[start:stop]
+        undo_stack = self.undo_stack
+        if undo_stack is not None:
+            new_stop = start + len(new_children)
+
+            def undo():
+                super(HkbXmlElement, self).__setitem__(
+                    slice(start, new_stop), old_children
+                )
+
+            def redo():
+                super(HkbXmlElement, self).__setitem__(
+                    slice(start, stop), new_children
+                )
+
+            undo_stack.record(
+                MutationType.STRUCTURE,
+                undo,
+                redo,
+                element=self,
+                deltas=lambda: splice_deltas(
+                    self, *slice(start, stop).indices(len(self))[:2], new_children
+                ),
+            )
+
+        super(HkbXmlElement, self).__setitem__(slice(start, stop), new_children)
+        if undo_stack is not None:
+            undo_stack.notify()
 
     def replace(self, old_element, new_element):
         self._check_move(new_element)
         undo_stack = self.undo_stack
         if undo_stack is not None:
-            index = list(self).index(old_element)
-
             def undo():
-                super(HkbXmlElement, self).remove(new_element)
-                super(HkbXmlElement, self).insert(index, old_element)
+                super(HkbXmlElement, self).replace(new_element, old_element)
 
             def redo():
-                super(HkbXmlElement, self).remove(old_element)
-                super(HkbXmlElement, self).insert(index, new_element)
+                super(HkbXmlElement, self).replace(old_element, new_element)
 
-            undo_stack.record(MutationType.STRUCTURE, undo, redo)
+            undo_stack.record(
+                MutationType.STRUCTURE,
+                undo,
+                redo,
+                element=self,
+                deltas=lambda: replace_deltas(old_element, new_element),
+            )
 
         super(HkbXmlElement, self).replace(old_element, new_element)
+        if undo_stack is not None:
+            undo_stack.notify()
 
     def addnext(self, element):
         self._check_move(element)
@@ -504,9 +782,13 @@ class HkbXmlElement(ET.ElementBase):
                 MutationType.STRUCTURE,
                 undo_fn=lambda: parent.remove(element) if parent is not None else None,
                 redo_fn=lambda: super(HkbXmlElement, self).addnext(element),
+                element=parent,
+                deltas=lambda: _sibling_deltas(self, element, 1),
             )
 
         super(HkbXmlElement, self).addnext(element)
+        if undo_stack is not None:
+            undo_stack.notify()
 
     def addprevious(self, element):
         self._check_move(element)
@@ -518,9 +800,252 @@ class HkbXmlElement(ET.ElementBase):
                 MutationType.STRUCTURE,
                 undo_fn=lambda: parent.remove(element) if parent is not None else None,
                 redo_fn=lambda: super(HkbXmlElement, self).addprevious(element),
+                element=parent,
+                deltas=lambda: _sibling_deltas(self, element, 0),
             )
 
         super(HkbXmlElement, self).addprevious(element)
+        if undo_stack is not None:
+            undo_stack.notify()
+
+
+def element_path(element: ET.Element, by_id: bool = True) -> tuple[int | str, ...]:
+    """Get the path used to address an element in deltas.
+
+    All objects share the same parent, so finding an object's index is O(number of objects). Elements inside an object are therefore addressed by the object's ID followed by the child indices inside the object. Anything else is addressed by the child indices from the root.
+
+    Parameters
+    ----------
+    element : ET.Element
+        The element to address.
+    by_id : bool, optional
+        Whether to address objects by their ID.
+
+    Returns
+    -------
+    tuple[int | str, ...]
+        The path to the element.
+    """
+    path = []
+    parent = element.getparent()
+
+    while parent is not None:
+        if by_id and element.tag == "object":
+            object_id = element.get("id")
+            if object_id:
+                path.append(object_id)
+                break
+
+        path.append(parent.index(element))
+        element = parent
+        parent = element.getparent()
+
+    path.reverse()
+    return tuple(path)
+
+
+def _path_after_insert(anchor: ET.Element, element: ET.Element, offset: int) -> tuple:
+    # Path the element will have once it has been inserted next to the anchor
+    if element.tag == "object" and element.get("id"):
+        return (element.get("id"),)
+
+    path = element_path(anchor)
+    if isinstance(path[-1], str):
+        # The anchor is an object, fall back to indices (rare)
+        path = element_path(anchor, by_id=False)
+
+    return path[:-1] + (path[-1] + offset,)
+
+
+def element_to_str(element: ET.Element) -> str:
+    return ET.tostring(element, encoding="unicode", with_tail=False)
+
+
+def attrib_deltas(
+    element: ET.Element, new_values: dict[str, str], old_values: dict[str, str]
+) -> tuple[Delta, Delta]:
+    path = element_path(element)
+    return (("attribs", path, new_values), ("attribs", path, old_values))
+
+
+def text_deltas(
+    element: ET.Element, which: str, new_value: str, old_value: str
+) -> tuple[Delta, Delta]:
+    path = element_path(element)
+    return ((which, path, new_value), (which, path, old_value))
+
+
+def splice_deltas(
+    parent: ET.Element, start: int, stop: int, new_children: list[ET.Element]
+) -> tuple[Delta, Delta]:
+    path = element_path(parent)
+    old_children = [element_to_str(c) for c in parent[start:stop]]
+    new_children = [element_to_str(c) for c in new_children]
+
+    return (
+        ("splice", path, start, stop, new_children),
+        ("splice", path, start, start + len(new_children), old_children),
+    )
+
+
+def append_deltas(
+    parent: ET.Element, new_children: list[ET.Element]
+) -> tuple[Delta, Delta]:
+    # Appending and removing the last children doesn't need to count the siblings
+    path = element_path(parent)
+    return (
+        ("append", path, [element_to_str(c) for c in new_children]),
+        ("pop", path, len(new_children)),
+    )
+
+
+def remove_deltas(
+    parent: ET.Element, child: ET.Element, anchor: ET.Element
+) -> tuple[Delta, Delta]:
+    if anchor is None:
+        undo = ("splice", element_path(parent), 0, 0, [element_to_str(child)])
+    else:
+        undo = ("addnext", element_path(anchor), element_to_str(child))
+
+    return (("remove", element_path(child)), undo)
+
+
+def replace_deltas(
+    old_element: ET.Element, new_element: ET.Element
+) -> tuple[Delta, Delta]:
+    old_path = element_path(old_element)
+    if isinstance(old_path[-1], int):
+        # The new element will be in the same place
+        new_path = old_path
+    else:
+        new_path = _path_after_insert(old_element, new_element, 0)
+
+    return (
+        ("replace", old_path, element_to_str(new_element)),
+        ("replace", new_path, element_to_str(old_element)),
+    )
+
+
+def _insert_range(parent: ET.Element, index: int) -> tuple[int, int]:
+    # Where lxml will actually insert the child
+    if index < 0:
+        index = max(len(parent) + index, 0)
+
+    index = min(index, len(parent))
+    return (index, index)
+
+
+def _sibling_deltas(
+    anchor: ET.Element, element: ET.Element, offset: int
+) -> tuple[Delta, Delta]:
+    if anchor.getparent() is None:
+        # Siblings of the root are not part of the tree
+        return (None, None)
+
+    op = "addnext" if offset else "addprevious"
+    return (
+        (op, element_path(anchor), element_to_str(element)),
+        ("remove", _path_after_insert(anchor, element, offset)),
+    )
+
+
+def _find_object(
+    root: ET.Element, object_id: str, objects: dict[str, ET.Element]
+) -> ET.Element:
+    if objects is None:
+        return root.xpath(".//object[@id=$oid]", oid=object_id)[0]
+
+    obj = objects.get(object_id)
+    if obj is None or obj.get("id") != object_id or obj.getparent() is None:
+        # Unknown or stale, e.g. objects added before the index was passed in
+        objects.clear()
+        objects.update((o.get("id"), o) for o in root.iter("object"))
+        obj = objects[object_id]
+
+    return obj
+
+
+def _register_objects(
+    elements: list[ET.Element], objects: dict[str, ET.Element]
+) -> None:
+    if objects is not None:
+        for elem in elements:
+            if elem.tag == "object" and elem.get("id"):
+                objects[elem.get("id")] = elem
+
+
+def apply_delta(
+    root: ET.Element, delta: Delta, objects: dict[str, ET.Element] = None
+) -> None:
+    """Apply a recorded mutation to an xml tree that is in the same state the original tree was in when the mutation was recorded. Changes are made through the regular element methods, so they will be recorded by the tree's undo stack (if any).
+
+    Parameters
+    ----------
+    root : ET.Element
+        The root of the tree to modify.
+    delta : Delta
+        The mutation to apply.
+    objects : dict[str, ET.Element], optional
+        Object elements by ID, used to resolve paths. Will be updated as objects are added, so that it can be reused when applying many deltas. If not provided, objects are searched in the tree.
+    """
+    op, path, *args = delta
+
+    element = root
+    if path and isinstance(path[0], str):
+        element = _find_object(root, path[0], objects)
+        path = path[1:]
+
+    for idx in path:
+        element = element[idx]
+
+    if op == "attribs":
+        for key, value in args[0].items():
+            if value is None:
+                element.attrib.pop(key, None)
+            else:
+                element.set(key, value)
+    elif op == "text":
+        element.text = args[0]
+    elif op == "tail":
+        element.tail = args[0]
+    elif op == "splice":
+        start, stop, children = args
+        new_children = [xml_from_str(c) for c in children]
+        if isinstance(element, HkbXmlElement):
+            element.splice(start, stop, new_children)
+        else:
+            element[start:stop] = new_children
+        _register_objects(new_children, objects)
+    elif op == "append":
+        new_children = [xml_from_str(c) for c in args[0]]
+        element.extend(new_children)
+        _register_objects(new_children, objects)
+    elif op == "pop":
+        for _ in range(args[0]):
+            element.remove(element[-1])
+    elif op == "remove":
+        element.getparent().remove(element)
+    elif op in ("addnext", "addprevious", "replace"):
+        new_element = xml_from_str(args[0])
+        if op == "replace":
+            element.getparent().replace(element, new_element)
+        else:
+            getattr(element, op)(new_element)
+        _register_objects([new_element], objects)
+    elif op == "element":
+        source = xml_from_str(args[0])
+        children = list(source)
+        # Detach the children so they aren't reported as being moved
+        for child in children:
+            source.remove(child)
+
+        element.clear()
+        for key, value in source.items():
+            element.set(key, value)
+        element.text = source.text
+        element.extend(children)
+    else:
+        raise ValueError(f"Unknown delta operation {op}")
 
 
 def _get_xml_parser() -> ET.XMLParser:
@@ -544,7 +1069,7 @@ def make_subelement(parent: ET.Element, tag: str, **kwargs) -> HkbXmlElement:
 
 
 def xml_from_str(xml: str, undo: bool = False) -> HkbXmlElement:
-    from hkb_editor.external import get_config
+    from hkb_editor.external import Config, get_config
 
     tree = ET.fromstring(xml, parser=_get_xml_parser())
     if hasattr(tree, "getroot"):
@@ -553,17 +1078,20 @@ def xml_from_str(xml: str, undo: bool = False) -> HkbXmlElement:
         root = tree.getroottree().getroot()
 
     if undo:
-        HkbXmlElement._undo_stacks[root] = UndoStack(get_config().undo_history)
+        config = get_config() or Config()
+        HkbXmlElement._undo_stacks[root] = UndoStack(config.undo_history)
     return root
 
 
 def xml_from_file(path: str, undo: bool = False) -> HkbXmlElement:
-    from hkb_editor.external import get_config
+    from hkb_editor.external import Config, get_config
 
     tree = ET.parse(path, parser=_get_xml_parser())
     root = tree.getroot()
     if undo:
-        HkbXmlElement._undo_stacks[root] = UndoStack(get_config().undo_history)
+        # Headless tools may run without loading a config
+        config = get_config() or Config()
+        HkbXmlElement._undo_stacks[root] = UndoStack(config.undo_history)
     return root
 
 
@@ -454,9 +454,11 @@ class CommonActionsMixin:
         bindings: HkbArray = binding_set["bindings"]
         bnd: HkbRecord
 
-        for idx, bnd in enumerate(bindings):
-            if bnd["memberPath"].get_value() == path:
-                bindings.pop(idx)
+        bindings.delete_indices(
+            idx
+            for idx, bnd in enumerate(bindings)
+            if bnd["memberPath"].get_value() == path
+        )
 
     def new_record(
         self,
@@ -355,6 +355,35 @@ class TemplateContext(CommonActionsMixin):
 
         return idx
 
+    def array_extend(
+        self, record: HkbRecord | str, path: str, items: list[Any]
+    ) -> int:
+        """Append several values to an array field of the specified record in one step.
+
+        Note that when appending to pointer arrays you need to pass object IDs, not actual objects.
+
+        Parameters
+        ----------
+        record : HkbRecord | str
+            The record holding the array.
+        path : str
+            Path to the array within the record, with deeper levels separated by /.
+        items : list[Any]
+            The items to append to the array.
+
+        Returns
+        -------
+            The index of the first new item in the array.
+        """
+        record = self.resolve_object(record)
+        array: HkbArray = record.get_field(path)
+        idx = len(array)
+
+        array.extend(items)
+        self.logger.debug(f"Appended {len(items)} items to {path} of {record} (index={idx})")
+
+        return idx
+
     def array_pop(self, record: HkbRecord | str, path: str, index: int = -1) -> Any:
         """Remove a value from an array inside a record.
 